@@ -0,0 +1,217 @@
+#ifndef ARRIVAL_SOURCE_H
+#define ARRIVAL_SOURCE_H
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "read_file.h"
+
+/**
+ * @class ArrivalSource
+ * @brief Abstract class that yields the process parameters of a workload in
+ * creation time order. The kernel pulls arrivals from it one at a time, so
+ * the workload does not need to be materialized up front.
+ */
+class ArrivalSource {
+public:
+    virtual ~ArrivalSource() {}
+
+    /**
+     * @return The next arrival, or nullptr if there are no more arrivals. The
+     * pointer is valid until the next call to pop or rewind.
+     */
+    virtual const ProcessParams* peek() = 0;
+
+    /**
+     * @brief Consumes the next arrival.
+     */
+    virtual void pop() = 0;
+
+    /**
+     * @brief Goes back to the first arrival, so the workload can be simulated
+     * again with another scheduler.
+     */
+    virtual void rewind() = 0;
+
+    /**
+     * @return The total number of arrivals of the workload.
+     */
+    virtual unsigned long size() = 0;
+};
+
+/**
+ * @class VectorArrivalSource
+ * @brief Yields the arrivals of a workload that is fully in memory, sorted by
+ * creation time. Processes created at the same time keep their order in the
+ * workload, as with the external sort.
+ */
+class VectorArrivalSource : public ArrivalSource {
+public:
+    VectorArrivalSource(std::vector<ProcessParams *> processes_params) :
+        VectorArrivalSource(std::vector<const ProcessParams *>(
+            processes_params.begin(), processes_params.end())) {}
+
+    VectorArrivalSource(std::vector<const ProcessParams *> processes_params) :
+        params_queue(std::move(processes_params)),
+        position(0) {
+        std::stable_sort(
+            params_queue.begin(),
+            params_queue.end(),
+            CompareProcessParams());
+    }
+
+    ~VectorArrivalSource() {}
+
+    const ProcessParams* peek() override {
+        return position < params_queue.size() ? params_queue[position] : nullptr;
+    }
+
+    void pop() override {
+        position++;
+    }
+
+    void rewind() override {
+        position = 0;
+    }
+
+    unsigned long size() override {
+        return params_queue.size();
+    }
+
+private:
+    struct CompareProcessParams {
+        bool operator()(const ProcessParams* lhs, const ProcessParams* rhs) const {
+            return lhs->get_creation_time() < rhs->get_creation_time();
+        }
+    };
+    std::vector<const ProcessParams *> params_queue;
+    std::size_t position;
+};
+
+/**
+ * @class SpanArrivalSource
+ * @brief Yields a span of arrivals already in creation time order, such as a
+ * part of a workload simulated on its own. The arrivals are not owned.
+ */
+class SpanArrivalSource : public ArrivalSource {
+public:
+    SpanArrivalSource(const ProcessParams* first_, const ProcessParams* last_) :
+        first(first_),
+        last(last_),
+        position(first_) {}
+
+    ~SpanArrivalSource() {}
+
+    const ProcessParams* peek() override {
+        return position < last ? position : nullptr;
+    }
+
+    void pop() override {
+        position++;
+    }
+
+    void rewind() override {
+        position = first;
+    }
+
+    unsigned long size() override {
+        return last - first;
+    }
+
+private:
+    const ProcessParams* first;
+    const ProcessParams* last;
+    const ProcessParams* position;
+};
+
+/**
+ * @class TraceArrivalSource
+ * @brief Yields the arrivals of a workload file that is already sorted by
+ * creation time, in the order of the file, from a byte offset on. Used by the
+ * incremental runs, which only read the lines appended after the arrivals
+ * they restore from a snapshot.
+ *
+ * The first arrival read is numbered skipped_ + 1, and size counts the
+ * skipped ones. The source also finds where the arrivals of the last creation
+ * time begin, the boundary at which the next snapshot is taken.
+ */
+class TraceArrivalSource : public ArrivalSource {
+public:
+    TraceArrivalSource(const std::string& file_name,
+                       uint64_t offset,
+                       unsigned long skipped_) :
+        skipped(skipped_),
+        position(0),
+        sorted(true),
+        last_offset(offset) {
+        std::ifstream file(file_name, std::ios::binary);
+        file.seekg(static_cast<std::streamoff>(offset));
+        ProcessParams params(0, 0, 0);
+        uint64_t line_offset = offset;
+        while (ProcessParams::read(file, params)) {
+            if (!params_list.empty()) {
+                unsigned long last = params_list.back().get_creation_time();
+                if (params.get_creation_time() < last)
+                    sorted = false;
+                else if (params.get_creation_time() > last)
+                    last_offset = line_offset;
+            }
+            params_list.push_back(params);
+            std::streamoff next = file.tellg();
+            if (next >= 0)
+                line_offset = static_cast<uint64_t>(next);
+        }
+    }
+
+    ~TraceArrivalSource() {}
+
+    const ProcessParams* peek() override {
+        return position < params_list.size() ? &params_list[position] : nullptr;
+    }
+
+    void pop() override {
+        position++;
+    }
+
+    void rewind() override {
+        position = 0;
+    }
+
+    unsigned long size() override {
+        return skipped + params_list.size();
+    }
+
+    /**
+     * @return False if a line of the file is created before the line above it.
+     */
+    bool is_sorted() const {
+        return sorted;
+    }
+
+    /**
+     * @return The creation time of the last arrival, or ULONG_MAX if no
+     * arrival was read.
+     */
+    unsigned long last_creation_time() const {
+        return params_list.empty() ?
+               ULONG_MAX : params_list.back().get_creation_time();
+    }
+
+    /**
+     * @return The offset of the first line created at last_creation_time.
+     */
+    uint64_t last_creation_offset() const {
+        return last_offset;
+    }
+
+private:
+    unsigned long skipped;
+    std::vector<ProcessParams> params_list;
+    std::size_t position;
+    bool sorted;
+    uint64_t last_offset;
+};
+
+#endif // ARRIVAL_SOURCE_H
@@ -0,0 +1,308 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "arrival_source.h"
+#include "read_file.h"
+
+/**
+ * @class BatchEngine
+ * @brief Simulates many small independent workloads with FCFS or Round Robin
+ * in lockstep, one workload per lane of a vector register.
+ *
+ * Each lane holds the state of its workload as a few times: its next
+ * arrival, and the end and next quantum boundary of the slice of its running
+ * process. At every step each lane handles its earliest event: an arrival, a
+ * process that finishes, or a process preempted at a quantum boundary. The
+ * lanes pick and time their events together, with masks, and only the loads
+ * and stores of the processes and ready queues are done lane by lane. A lane
+ * whose workload is done takes the next one, so the lanes stay busy until the
+ * last workloads.
+ *
+ * The events follow the order of the simulation of the kernel second by
+ * second: arrivals first, then the end of the slice, and a process that ends
+ * its burst at a quantum boundary is not preempted. Processes of a workload
+ * are numbered in the order of VectorArrivalSource, so the statistics are
+ * the same as the ones of the kernel.
+ *
+ * The build targets no particular instruction set, so the lanes are GCC
+ * vector extensions, which the compiler maps to the SIMD registers of the
+ * target, rather than AVX intrinsics.
+ */
+class BatchEngine {
+public:
+    // 32 bit lanes of a 128 bit register, the width every target of the
+    // build has (SSE2 on x86-64, NEON on ARM).
+    static const unsigned LANES = 4;
+
+    // A workload, in creation time order.
+    struct Workload {
+        std::string name;
+        std::vector<uint32_t> creation;
+        std::vector<uint32_t> duration;
+    };
+
+    // The statistics of a process, as the kernel keeps them.
+    struct ProcessResult {
+        unsigned long start;
+        unsigned long end;
+        unsigned long waiting_time;
+        unsigned long context_changes;
+    };
+
+    BatchEngine(bool round_robin_, unsigned long quantum_) :
+        round_robin(round_robin_),
+        quantum(static_cast<uint32_t>(quantum_ ? quantum_ : 1)) {}
+
+    ~BatchEngine() {}
+
+    /**
+     * @brief Reads a workload file and orders its processes as the kernel
+     * does. Fails on processes with I/O bursts, which the engine does not
+     * simulate, and on workloads that would run past the 32-bit times of the
+     * engine.
+     *
+     * @return False if the file cannot be read, has I/O bursts or is too long.
+     */
+    static bool load(const std::string& file_name, Workload& workload) {
+        std::ifstream file(file_name);
+        if (!file.is_open())
+            return false;
+        std::vector<ProcessParams*> params;
+        ProcessParams read(0, 0, 0);
+        bool has_io = false;
+        while (ProcessParams::read(file, read)) {
+            has_io |= !read.get_bursts().empty();
+            params.push_back(new ProcessParams(read));
+        }
+        VectorArrivalSource arrivals(params);
+        workload.name = file_name;
+        workload.creation.clear();
+        workload.duration.clear();
+        // The processes are done by done_by at the latest, which must stay
+        // below INF.
+        unsigned long done_by = 0;
+        bool fits = true;
+        for (const ProcessParams* process; (process = arrivals.peek());
+             arrivals.pop()) {
+            done_by = std::max(done_by, process->get_creation_time());
+            if (done_by >= INF || process->get_duration() >= INF - done_by) {
+                fits = false;
+                break;
+            }
+            done_by += process->get_duration();
+            workload.creation.push_back(
+                static_cast<uint32_t>(process->get_creation_time()));
+            workload.duration.push_back(
+                static_cast<uint32_t>(process->get_duration()));
+        }
+        for (ProcessParams* process : params)
+            delete process;
+        return !has_io && fits;
+    }
+
+    /**
+     * @brief Simulates every workload. results[i] gets the statistics of the
+     * processes of workloads[i], by pid.
+     */
+    void run(const std::vector<Workload>& workloads,
+             std::vector<std::vector<ProcessResult>>& results) {
+        results.assign(workloads.size(), {});
+        std::size_t next_workload = 0;
+        for (unsigned lane = 0; lane < LANES; lane++) {
+            lanes[lane].workload = nullptr;
+            lanes[lane].current = NONE;
+            next_arrival[lane] = INF;
+            done_time[lane] = INF;
+            boundary[lane] = INF;
+            slice_start[lane] = 0;
+            slice_executed[lane] = 0;
+        }
+
+        while (true) {
+            // Picks the event of each lane.
+            Lanes slice_end = select(done_time < boundary, done_time, boundary);
+            Mask active = (next_arrival != INF) | (slice_end != INF);
+            Mask arrives = active & (next_arrival <= slice_end);
+            Mask finishes = active & ~arrives & (done_time <= boundary);
+            Lanes now = select(arrives, next_arrival, slice_end);
+
+            bool running = false;
+            Mask dispatched = {};
+            Lanes boundary_from = infinity();
+            Lanes remaining = {};
+            for (unsigned lane = 0; lane < LANES; lane++) {
+                if (!active[lane]) {
+                    if (lanes[lane].workload)
+                        results[lanes[lane].index].swap(lanes[lane].results);
+                    lanes[lane].workload = nullptr;
+                    if (next_workload < workloads.size()) {
+                        load_lane(lane, workloads[next_workload], next_workload);
+                        next_workload++;
+                        running = true;
+                    }
+                    continue;
+                }
+                running = true;
+                if (arrives[lane])
+                    arrive(lane, now[lane], boundary_from);
+                else if (finishes[lane])
+                    finish(lane, now[lane]);
+                else
+                    preempt(lane, now[lane]);
+                if (lanes[lane].dispatched) {
+                    lanes[lane].dispatched = false;
+                    dispatched[lane] = -1;
+                    remaining[lane] = lanes[lane].remaining;
+                    boundary_from[lane] = round_robin && lanes[lane].size ?
+                                          now[lane] + 1 : INF;
+                }
+            }
+            if (!running)
+                break;
+
+            // Times the slices of the processes dispatched: they run at least
+            // a second, and until their quantum boundary if some process waits.
+            slice_start = select(dispatched, now, slice_start);
+            done_time = select(dispatched, now + remaining, done_time);
+            done_time = select(finishes & ~dispatched, infinity(), done_time);
+            Lanes executed = slice_executed + (boundary_from - slice_start);
+            Lanes left = executed % quantum;
+            Lanes next_boundary = boundary_from +
+                                  select(left != 0, quantum - left, Lanes{});
+            boundary = select(boundary_from != INF, next_boundary,
+                              select(dispatched | finishes, infinity(),
+                                     boundary));
+        }
+    }
+
+private:
+    typedef uint32_t Lanes __attribute__((vector_size(LANES * sizeof(uint32_t))));
+    typedef int32_t Mask __attribute__((vector_size(LANES * sizeof(int32_t))));
+
+    static const uint32_t INF = UINT32_MAX;
+    static const uint32_t NONE = UINT32_MAX;
+
+    // The processes and the ready queue of the workload of a lane.
+    struct Lane {
+        const Workload* workload;
+        std::size_t index;
+        std::vector<ProcessResult> results;
+        std::vector<uint32_t> executed;     // At the start of the last slice
+        std::vector<uint32_t> ready_since;
+        std::vector<uint32_t> queue;        // Ring of size processes
+        uint32_t head;
+        uint32_t size;
+        uint32_t next;                      // Next process to arrive
+        uint32_t current;                   // NONE if the CPU is idle
+        bool dispatched;                    // During the last event
+        uint32_t remaining;                 // Of the process dispatched
+    };
+
+    bool round_robin;
+    uint32_t quantum;
+    Lane lanes[LANES];
+    Lanes next_arrival;
+    Lanes done_time;        // End of the slice of the running process
+    Lanes boundary;         // Next quantum boundary at which it is preempted
+    Lanes slice_start;
+    Lanes slice_executed;   // Execution time of the running process then
+
+    static Lanes infinity() {
+        return Lanes{} + INF;
+    }
+
+    static Lanes select(Mask mask, Lanes when_true, Lanes when_false) {
+        Lanes bits = reinterpret_cast<Lanes&>(mask);
+        return (when_true & bits) | (when_false & ~bits);
+    }
+
+    void load_lane(unsigned lane, const Workload& workload, std::size_t index) {
+        Lane& state = lanes[lane];
+        std::size_t count = workload.creation.size();
+        state.workload = &workload;
+        state.index = index;
+        state.results.assign(count, {ULONG_MAX, 0, 0, 0});
+        state.executed.assign(count, 0);
+        state.ready_since.assign(count, 0);
+        state.queue.resize(count);
+        state.head = 0;
+        state.size = 0;
+        state.next = 0;
+        state.current = NONE;
+        state.dispatched = false;
+        next_arrival[lane] = count ? workload.creation[0] : INF;
+        done_time[lane] = INF;
+        boundary[lane] = INF;
+    }
+
+    void push(Lane& state, uint32_t process) {
+        std::size_t tail = state.head + state.size;
+        if (tail >= state.queue.size())
+            tail -= state.queue.size();
+        state.queue[tail] = process;
+        state.size++;
+    }
+
+    void dispatch(unsigned lane, uint32_t now) {
+        Lane& state = lanes[lane];
+        uint32_t process = state.queue[state.head];
+        if (++state.head == state.queue.size())
+            state.head = 0;
+        state.size--;
+        ProcessResult& result = state.results[process];
+        result.start = std::min<unsigned long>(result.start, now);
+        result.waiting_time += now - state.ready_since[process];
+        result.context_changes++;
+        state.current = process;
+        uint32_t duration = state.workload->duration[process];
+        uint32_t executed = state.executed[process];
+        state.remaining = duration > executed ? duration - executed : 1;
+        state.dispatched = true;
+        slice_executed[lane] = executed;
+    }
+
+    void arrive(unsigned lane, uint32_t now, Lanes& boundary_from) {
+        Lane& state = lanes[lane];
+        uint32_t process = state.next++;
+        next_arrival[lane] = state.next < state.workload->creation.size() ?
+                             state.workload->creation[state.next] : INF;
+        // As in the kernel, processes without duration are never scheduled.
+        if (!state.workload->duration[process])
+            return;
+        state.ready_since[process] = now;
+        push(state, process);
+        if (state.current == NONE) {
+            dispatch(lane, now);
+        } else if (round_robin && boundary[lane] == INF) {
+            // A process waits now, so the running one is preempted at its
+            // next quantum boundary, which may be now.
+            boundary_from[lane] = std::max(now, slice_start[lane] + 1);
+        }
+    }
+
+    void finish(unsigned lane, uint32_t now) {
+        Lane& state = lanes[lane];
+        state.results[state.current].end = now;
+        state.current = NONE;
+        if (state.size)
+            dispatch(lane, now);
+    }
+
+    void preempt(unsigned lane, uint32_t now) {
+        Lane& state = lanes[lane];
+        uint32_t process = state.current;
+        state.executed[process] = slice_executed[lane] +
+                                  (now - slice_start[lane]);
+        state.ready_since[process] = now;
+        push(state, process);
+        dispatch(lane, now);
+    }
+};
+
+#endif // BATCH_H
@@ -1,12 +1,67 @@
 #ifndef CPU_H
 #define CPU_H
 
+#include <cmath>
+#include <iomanip>
 #include <iostream>
+#include <unordered_map>
 #include <vector>
 #include <random>
 #include "context.h"
 #include "memory.h"
 
+/**
+ * @class SwitchCost
+ * @brief The time the CPU loses when it switches to another process: a fixed
+ * cost to save and load the contexts, plus the time to refill the cache of
+ * the process in proportion to how cold it is.
+ *
+ * The cache of a process that never ran is cold. Otherwise, each dispatch of
+ * another process since it last ran evicts half of what it had left, and so
+ * does every half_life seconds since then.
+ */
+class SwitchCost {
+public:
+    SwitchCost() : fixed(0), refill(0), half_life(DEFAULT_HALF_LIFE) {}
+
+    /**
+     * @param fixed_ Cost of every switch, in milliseconds.
+     * @param refill_ Cost of refilling a cold cache, in milliseconds.
+     * @param half_life_ Seconds in which a cache loses half of its content.
+     */
+    SwitchCost(double fixed_, double refill_, double half_life_) :
+        fixed(fixed_), refill(refill_), half_life(half_life_) {}
+
+    bool enabled() const {
+        return fixed > 0 || refill > 0;
+    }
+
+    /**
+     * @return The cost, in milliseconds, of switching to a process that last
+     * ran elapsed seconds ago, with others dispatches of other processes
+     * since.
+     */
+    double cost(unsigned long elapsed, unsigned long others) const {
+        double warmth = std::exp2(-static_cast<double>(others) -
+                                  static_cast<double>(elapsed) / half_life);
+        return fixed + refill * (1 - warmth);
+    }
+
+    /**
+     * @return The cost of switching to a process that never ran.
+     */
+    double cold_cost() const {
+        return fixed + refill;
+    }
+
+    static constexpr double DEFAULT_HALF_LIFE = 10;
+
+private:
+    double fixed;
+    double refill;
+    double half_life;
+};
+
 /**
  * @class CPU
  * @brief Represents the CPU and its contents.
@@ -14,15 +69,108 @@
  */
 class CPU {
 public:
-    CPU() {
+    CPU() : generator(std::random_device()()), distribution(0, 100) {
         registers = std::vector<unsigned long>(6);
         sp = 0;
         pc = 0;
         st = 0;
+        set_switch_cost(SwitchCost());
     }
 
     ~CPU() {}
 
+    /**
+     * @brief Sets the cost of switching between processes and forgets the
+     * processes that ran and the time charged so far.
+     */
+    void set_switch_cost(const SwitchCost& switch_cost_) {
+        switch_cost = switch_cost_;
+        history.clear();
+        last_pid = 0;
+        switches = 0;
+        overhead = 0;
+        debt = 0;
+        busy_seconds = 0;
+        switching_seconds = 0;
+        end_time = 0;
+    }
+
+    bool has_switch_cost() const {
+        return switch_cost.enabled();
+    }
+
+    /**
+     * @brief Charges the switch to pid, dispatched for the second starting at
+     * current_time, if another process ran last. The costs add up in
+     * milliseconds and the CPU spends a whole second switching each time
+     * they reach one, so short quanta lose time in proportion.
+     *
+     * @return True if the CPU spends that second switching to pid instead of
+     * running it.
+     */
+    bool switch_to(unsigned long pid, unsigned long current_time) {
+        if (!switch_cost.enabled())
+            return false;
+        if (pid != last_pid) {
+            RunHistory& run = history.try_emplace(pid, RunHistory{0, 0, false})
+                              .first->second;
+            double cost = run.ran ?
+                          switch_cost.cost(current_time - run.last_time,
+                                           switches - run.switches) :
+                          switch_cost.cold_cost();
+            switches++;
+            overhead += cost;
+            debt += cost;
+            run.switches = switches;
+            run.ran = true;
+            last_pid = pid;
+        }
+        if (debt < 1000)
+            return false;
+        debt -= 1000;
+        return true;
+    }
+
+    /**
+     * @brief Records that pid had the CPU for seconds from current_time,
+     * running or, if switching, switching to it.
+     */
+    void account(unsigned long pid, unsigned long current_time,
+                 unsigned long seconds, bool switching) {
+        if (!switch_cost.enabled())
+            return;
+        // A process that finished in these seconds may be released already.
+        auto run = history.find(pid);
+        if (run != history.end())
+            run->second.last_time = current_time + seconds;
+        if (switching)
+            switching_seconds += seconds;
+        else
+            busy_seconds += seconds;
+        end_time = current_time + seconds;
+    }
+
+    /**
+     * @brief Prints the switches, their overhead and how the CPU time was
+     * spent up to the end of the last process.
+     */
+    void print_report() const {
+        if (!switch_cost.enabled())
+            return;
+        double total = end_time ? static_cast<double>(end_time) : 1;
+        unsigned long idle_seconds = end_time - busy_seconds - switching_seconds;
+        std::cout << "Switch cost: " << switches << " switches, "
+                  << std::fixed << std::setprecision(3) << overhead / 1000
+                  << "s of overhead, " << switching_seconds
+                  << "s charged" << std::endl
+                  << "CPU: " << std::setprecision(2)
+                  << 100 * busy_seconds / total << "% useful, "
+                  << 100 * switching_seconds / total << "% switching, "
+                  << 100 * idle_seconds / total << "% idle" << std::endl;
+        std::cout.unsetf(std::ios::floatfield);
+        std::cout << std::setprecision(6);
+    }
+
     /**
      * @brief Processes a process. If the process was already running, it will
      * continue to run. Otherwise, it will load the context of the process.
@@ -50,19 +198,24 @@ public:
         std::cout   << std::endl;
         #endif
 
-        // Simulates the process running for one second.
-        // Prepares to generate a random number.
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        std::uniform_int_distribution<> dis(0, 100);
-
-        // Sets each information of the cpu state to a random number.
+        // Simulates the process running for one second by setting each
+        // information of the cpu state to a random number. The generator is
+        // seeded once, as seeding it costs far more than a simulated second.
         for (int n = 1; n < 6; ++n) {
-            registers[n] = dis(gen);
+            registers[n] = distribution(generator);
         }
-        sp = dis(gen);
-        pc = dis(gen);
-        st = dis(gen);
+        sp = distribution(generator);
+        pc = distribution(generator);
+        st = distribution(generator);
+    }
+
+    /**
+     * @brief Forgets the saved context and the run history of a process that
+     * is done.
+     */
+    void release(unsigned long pid) {
+        memory.free_context(pid);
+        history.erase(pid);
     }
 
     /**
@@ -119,6 +272,25 @@ private:
     unsigned long sp; // Stack Pointer
     unsigned long pc; // Program Counter
     unsigned long st; // Status
+    std::mt19937 generator;
+    std::uniform_int_distribution<> distribution;
+
+    // When a process last had the CPU, by pid, until it is released.
+    struct RunHistory {
+        unsigned long last_time;
+        unsigned long switches;     // Value of switches when it got the CPU
+        bool ran;
+    };
+
+    SwitchCost switch_cost;
+    std::unordered_map<unsigned long, RunHistory> history;
+    unsigned long last_pid;
+    unsigned long switches;
+    double overhead;                // Milliseconds
+    double debt;                    // Milliseconds not charged yet
+    unsigned long busy_seconds;
+    unsigned long switching_seconds;
+    unsigned long end_time;
 
     // Loads the context of a process from memory.
     void load_context(unsigned long pid) {
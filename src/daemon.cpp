@@ -0,0 +1,41 @@
+#include "daemon.h"
+
+/**
+ * @file daemon.cpp
+ * @brief Runs the scheduler as a daemon fed by live arrivals over a Unix
+ * domain socket (see SchedulingDaemon).
+ */
+int main(int argc, char** argv) {
+
+    // Arguments starting with "--" are options, the others are positional.
+    unsigned long tick_us = 0;
+    unsigned long max_live = 1000000;
+    std::vector<char*> args;
+    for (int i = 0; i < argc; i++) {
+        std::string argument(argv[i]);
+        if (argument.rfind("--tick-us=", 0) == 0) {
+            tick_us = std::strtoul(argument.c_str() + 10, nullptr, 10);
+        } else if (argument.rfind("--max-live=", 0) == 0) {
+            max_live = std::strtoul(argument.c_str() + 11, nullptr, 10);
+        } else if (argument.rfind("--", 0) == 0) {
+            std::cout << "Unknown option: " << argument << std::endl;
+            return 1;
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+
+    if (args.size() < 3) {
+        std::cout << "Usage: ./scheduler_daemon <socket_path> <scheduler_type> quantum (optional) [--tick-us=<microseconds>] [--max-live=<processes>]" << std::endl;
+        return 1;
+    }
+
+    unsigned long scheduler_type = atoi(args[2]);
+    unsigned long quantum = 2;
+    if (args.size() >= 4)
+        quantum = atoi(args[3]);
+
+    SchedulingDaemon daemon(args[1], scheduler_type, quantum, tick_us,
+                            std::max(1ul, max_live));
+    return daemon.run();
+}
@@ -0,0 +1,645 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+#include "kernel.h"
+
+/**
+ * @class LatencyHistogram
+ * @brief Log2 histogram of latencies in microseconds, used to report
+ * percentiles in O(1) memory.
+ */
+class LatencyHistogram {
+public:
+    LatencyHistogram() : buckets(64, 0), count(0), sum(0), max(0) {}
+
+    void add(unsigned long value) {
+        buckets[value ? 64 - __builtin_clzl(value) : 0]++;
+        count++;
+        sum += value;
+        max = std::max(max, value);
+    }
+
+    /**
+     * @return The upper bound of the bucket holding the given percentile.
+     */
+    unsigned long percentile(double p) const {
+        unsigned long target = count * p, seen = 0;
+        for (std::size_t b = 0; b < buckets.size(); b++) {
+            seen += buckets[b];
+            if (seen > target)
+                return b ? std::min(max, (1ul << b) - 1) : 0;
+        }
+        return max;
+    }
+
+    double average() const {
+        return count ? static_cast<double>(sum) / count : 0;
+    }
+
+    unsigned long get_max() const {
+        return max;
+    }
+
+private:
+    std::vector<unsigned long> buckets;
+    unsigned long count;
+    unsigned long sum;
+    unsigned long max;
+};
+
+/**
+ * @class SchedulingDaemon
+ * @brief Runs a scheduler on live arrivals received over a Unix domain
+ * socket.
+ *
+ * Clients write one process per line, either "<duration> <priority>" (it
+ * arrives now) or, as in the input file, "<creation> <duration> <priority>"
+ * (it arrives at that time, or now if that time has passed). The daemon
+ * answers each process with a "done" line and periodically sends a "stats"
+ * line with the throughput and latency metrics to every client.
+ *
+ * Everything runs on one epoll loop. Each read drains up to 64 KiB of lines,
+ * and all the arrivals of a tick are fed to the scheduler in one batch. With
+ * tick_us = 0 the simulation runs in virtual time: the clock advances as fast
+ * as possible while there is work and stops while idle. Otherwise a timerfd
+ * advances it by one tick every tick_us microseconds. Clients stop being read
+ * while max_live processes are in the system or while their own output is
+ * not being consumed, which bounds both memory and queueing latency.
+ */
+class SchedulingDaemon {
+public:
+    SchedulingDaemon(const std::string& socket_path_,
+                     unsigned long scheduler_type,
+                     unsigned long quantum,
+                     unsigned long tick_us_,
+                     unsigned long max_live_) :
+        socket_path(socket_path_),
+        scheduler(SchedulerFactory().create_scheduler(scheduler_type, quantum)),
+        tick_us(tick_us_),
+        max_live(max_live_),
+        current_time(0),
+        ran_pid(0),
+        pid_counter(0),
+        next_connection(1),
+        reading_paused(false),
+        received_count(0),
+        admitted(0),
+        completed(0),
+        total_turnaround(0),
+        total_waiting(0),
+        last_completed(0),
+        last_admitted(0) {}
+
+    ~SchedulingDaemon() {
+        for (auto& connection : connections) {
+            close(connection.second.fd);
+        }
+        for (auto& job : jobs)
+            delete job.second.process;
+        for (Process* process : retired)
+            delete process;
+        delete scheduler;
+        if (listen_fd >= 0) {
+            close(listen_fd);
+            unlink(socket_path.c_str());
+        }
+        for (int fd : {epoll_fd, tick_fd, stats_fd, signal_fd})
+            if (fd >= 0)
+                close(fd);
+    }
+
+    /**
+     * @brief Runs the event loop until SIGINT or SIGTERM.
+     * @return 0 on a clean shutdown, 1 if the socket could not be set up.
+     */
+    int run() {
+        if (!setup())
+            return 1;
+
+        std::cout << "Listening on " << socket_path << std::endl;
+        epoll_event events[MAX_EVENTS];
+        bool stopping = false;
+        while (!stopping) {
+            // Virtual time only waits for events while there is nothing to
+            // simulate.
+            int timeout = (!tick_us && has_work()) ? 0 : -1;
+            int n = epoll_wait(epoll_fd, events, MAX_EVENTS, timeout);
+            if (n < 0 && errno != EINTR)
+                break;
+
+            for (int i = 0; i < n; i++) {
+                int fd = events[i].data.fd;
+                if (fd == listen_fd) {
+                    accept_connections();
+                } else if (fd == signal_fd) {
+                    stopping = true;
+                } else if (fd == stats_fd) {
+                    read_timer(stats_fd);
+                    send_stats();
+                } else if (fd == tick_fd) {
+                    run_ticks(read_timer(tick_fd));
+                } else {
+                    handle_connection(fd, events[i].events);
+                }
+            }
+
+            if (!tick_us && has_work())
+                run_ticks(TICKS_PER_POLL);
+            update_backpressure();
+            flush_connections();
+        }
+
+        print_summary();
+        return 0;
+    }
+
+private:
+    static constexpr int MAX_EVENTS = 256;
+    static constexpr unsigned long TICKS_PER_POLL = 1024;
+    static constexpr unsigned long STATS_PERIOD_US = 1000000;
+    static constexpr std::size_t READ_SIZE = 1 << 16;
+    static constexpr std::size_t MAX_OUTPUT = 1 << 22;
+
+    typedef std::chrono::steady_clock Clock;
+
+    struct Connection {
+        int fd;
+        unsigned long id;
+        std::string input;
+        std::string output;
+        bool reading;
+        bool writing;
+        bool closed;                // The client sends nothing else
+        unsigned long unfinished;   // Processes sent and not reported yet
+    };
+
+    // A process in the system, with the client that submitted it.
+    struct Job {
+        Process* process;
+        unsigned long connection;
+        Clock::time_point received;
+        bool started;
+    };
+
+    // A received process waiting for its creation time. Processes with the
+    // same creation time are created in the order they were received.
+    struct Pending {
+        unsigned long creation_time;
+        unsigned long sequence;
+        unsigned long duration;
+        unsigned long priority;
+        unsigned long connection;
+        Clock::time_point received;
+    };
+    struct ComparePending {
+        bool operator()(const Pending& lhs, const Pending& rhs) const {
+            if (lhs.creation_time != rhs.creation_time)
+                return lhs.creation_time > rhs.creation_time;
+            return lhs.sequence > rhs.sequence;
+        }
+    };
+
+    std::string socket_path;
+    Scheduler* scheduler;
+    CPU cpu;
+    unsigned long tick_us;
+    unsigned long max_live;
+    unsigned long current_time;
+    unsigned long ran_pid;
+    unsigned long pid_counter;
+    unsigned long next_connection;
+    bool reading_paused;
+
+    int listen_fd = -1;
+    int epoll_fd = -1;
+    int tick_fd = -1;
+    int stats_fd = -1;
+    int signal_fd = -1;
+
+    std::unordered_map<int, Connection> connections;
+    std::unordered_map<unsigned long, int> connection_fds;
+    std::unordered_map<unsigned long, Job> jobs;
+    std::priority_queue<Pending, std::vector<Pending>, ComparePending> pending;
+    std::vector<Process*> arrivals;
+    std::vector<Process*> retired;
+
+    unsigned long received_count;
+    unsigned long admitted;
+    unsigned long completed;
+    unsigned long total_turnaround;
+    unsigned long total_waiting;
+    unsigned long last_completed;
+    unsigned long last_admitted;
+    LatencyHistogram admission_latency;
+    LatencyHistogram dispatch_latency;
+    Clock::time_point last_stats;
+
+    bool setup() {
+        signal(SIGPIPE, SIG_IGN);
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+        sigprocmask(SIG_BLOCK, &signals, nullptr);
+        signal_fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+
+        sockaddr_un address;
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (socket_path.size() >= sizeof(address.sun_path)) {
+            std::cout << "Socket path is too long: " << socket_path << std::endl;
+            return false;
+        }
+        std::strcpy(address.sun_path, socket_path.c_str());
+        unlink(socket_path.c_str());
+
+        listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listen_fd < 0 ||
+            bind(listen_fd, reinterpret_cast<sockaddr*>(&address),
+                 sizeof(address)) < 0 ||
+            listen(listen_fd, SOMAXCONN) < 0) {
+            std::cout << "Could not listen on " << socket_path << ": "
+                      << std::strerror(errno) << std::endl;
+            return false;
+        }
+
+        epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        watch(listen_fd, EPOLLIN);
+        watch(signal_fd, EPOLLIN);
+
+        stats_fd = start_timer(STATS_PERIOD_US);
+        watch(stats_fd, EPOLLIN);
+        if (tick_us) {
+            tick_fd = start_timer(tick_us);
+            watch(tick_fd, EPOLLIN);
+        }
+        last_stats = Clock::now();
+        return true;
+    }
+
+    void watch(int fd, uint32_t events) {
+        epoll_event event;
+        event.events = events;
+        event.data.fd = fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+    }
+
+    void rewatch(Connection& connection) {
+        epoll_event event;
+        event.events = 0;
+        if (connection.reading)
+            event.events |= EPOLLIN;
+        if (connection.writing)
+            event.events |= EPOLLOUT;
+        event.data.fd = connection.fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, connection.fd, &event);
+    }
+
+    int start_timer(unsigned long period_us) {
+        int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        itimerspec spec;
+        spec.it_interval.tv_sec = period_us / 1000000;
+        spec.it_interval.tv_nsec = (period_us % 1000000) * 1000;
+        spec.it_value = spec.it_interval;
+        timerfd_settime(fd, 0, &spec, nullptr);
+        return fd;
+    }
+
+    // Returns the number of expirations since the last read.
+    unsigned long read_timer(int fd) {
+        uint64_t expirations = 0;
+        if (read(fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+            return 0;
+        return expirations;
+    }
+
+    bool has_work() const {
+        return !jobs.empty() || !arrivals.empty() || !pending.empty();
+    }
+
+    void accept_connections() {
+        while (true) {
+            int fd = accept4(listen_fd, nullptr, nullptr,
+                             SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0)
+                return;
+            Connection connection;
+            connection.fd = fd;
+            connection.id = next_connection++;
+            connection.reading = !reading_paused;
+            connection.writing = false;
+            connection.closed = false;
+            connection.unfinished = 0;
+            connections[fd] = connection;
+            connection_fds[connection.id] = fd;
+            watch(fd, 0);
+            rewatch(connections[fd]);
+        }
+    }
+
+    void handle_connection(int fd, uint32_t events) {
+        auto found = connections.find(fd);
+        if (found == connections.end())
+            return;
+        Connection& connection = found->second;
+
+        if ((events & (EPOLLHUP | EPOLLERR)) ||
+            ((events & EPOLLOUT) && !flush(connection))) {
+            drop(connection);
+            return;
+        }
+        if (events & EPOLLIN) {
+            char buffer[READ_SIZE];
+            ssize_t n = read(fd, buffer, sizeof(buffer));
+            if (n > 0) {
+                connection.input.append(buffer, n);
+                parse_lines(connection);
+                return;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EINTR))
+                return;
+            if (n < 0) {
+                drop(connection);
+                return;
+            }
+            // A client that closed its side still gets the results of the
+            // processes it sent; flush_connections drops it after them.
+            connection.closed = true;
+            connection.reading = false;
+            rewatch(connection);
+        }
+    }
+
+    void drop(Connection& connection) {
+        flush(connection);
+        connection_fds.erase(connection.id);
+        close(connection.fd);
+        connections.erase(connection.fd);
+    }
+
+    // Turns every complete line of the connection input into an arrival.
+    void parse_lines(Connection& connection) {
+        Clock::time_point now = Clock::now();
+        std::size_t begin = 0, end;
+        while ((end = connection.input.find('\n', begin)) != std::string::npos) {
+            unsigned long values[3];
+            int count = parse_fields(connection.input.c_str() + begin,
+                                     connection.input.c_str() + end, values);
+            if (count == 2 || count == 3)
+                connection.unfinished++;
+            if (count == 2) {
+                pending.push({current_time, received_count++,
+                              values[0], values[1], connection.id, now});
+            } else if (count == 3) {
+                pending.push({std::max(values[0], current_time),
+                              received_count++, values[1], values[2],
+                              connection.id, now});
+            } else if (end > begin) {
+                connection.output += "error " +
+                    connection.input.substr(begin, end - begin) + "\n";
+            }
+            begin = end + 1;
+        }
+        connection.input.erase(0, begin);
+    }
+
+    // Reads the fields of the line from cursor to line_end: numbers without
+    // sign separated by blanks. Returns how many, or 0 if the line has
+    // anything else, more than three of them or a number out of range.
+    static int parse_fields(const char* cursor, const char* line_end,
+                            unsigned long values[3]) {
+        int count = 0;
+        while (true) {
+            while (cursor < line_end &&
+                   std::isspace(static_cast<unsigned char>(*cursor)))
+                cursor++;
+            if (cursor == line_end)
+                return count;
+            if (count == 3 || !std::isdigit(static_cast<unsigned char>(*cursor)))
+                return 0;
+            char* next;
+            errno = 0;
+            values[count++] = std::strtoul(cursor, &next, 10);
+            if (errno == ERANGE || (next < line_end &&
+                !std::isspace(static_cast<unsigned char>(*next))))
+                return 0;
+            cursor = next;
+        }
+    }
+
+    // Creates the processes that arrive at the current time.
+    void admit() {
+        Clock::time_point now = Clock::now();
+        while (!pending.empty() && pending.top().creation_time <= current_time) {
+            const Pending& arrival = pending.top();
+            Process* process = new Process(++pid_counter,
+                                           arrival.duration,
+                                           arrival.priority,
+                                           current_time);
+            admission_latency.add(microseconds(arrival.received, now));
+            jobs[process->get_pid()] = {process, arrival.connection,
+                                        arrival.received, false};
+            admitted++;
+            if (arrival.duration > 0)
+                arrivals.push_back(process);
+            else
+                complete(process, current_time);
+            pending.pop();
+        }
+    }
+
+    void run_ticks(unsigned long ticks) {
+        for (unsigned long i = 0; i < ticks; i++) {
+            // In virtual time, idle stretches before a future arrival are
+            // skipped.
+            if (!tick_us && jobs.empty() && !pending.empty())
+                current_time = std::max(current_time, pending.top().creation_time);
+            if (!tick_us && !has_work())
+                return;
+
+            admit();
+            scheduler->feed(arrivals, current_time);
+            arrivals.clear();
+
+            if (scheduler->has_preemption(current_time))
+                cpu.handle_preemption(ran_pid, scheduler->get_current_pid());
+
+            ran_pid = scheduler->run(current_time);
+
+            // The processes that finished before this tick were just replaced
+            // by the scheduler and can be freed.
+            for (Process* process : retired)
+                delete process;
+            retired.clear();
+
+            if (ran_pid) {
+                cpu.process(ran_pid);
+                Job& job = jobs[ran_pid];
+                if (!job.started) {
+                    job.started = true;
+                    dispatch_latency.add(microseconds(job.received, Clock::now()));
+                }
+                // A process that finished its last second is reported now;
+                // the scheduler marks it DONE at the next tick.
+                if (job.process->is_done())
+                    complete(job.process, current_time + 1);
+            }
+            ++current_time;
+        }
+    }
+
+    void complete(Process* process, unsigned long end) {
+        auto found = jobs.find(process->get_pid());
+        unsigned long turnaround = end - process->get_creation_time();
+        unsigned long start = process->get_duration() ?
+                              process->get_start() : end;
+        total_turnaround += turnaround;
+        total_waiting += process->get_waiting_time();
+        completed++;
+
+        auto fd = connection_fds.find(found->second.connection);
+        if (fd != connection_fds.end()) {
+            std::ostringstream line;
+            line << "done " << process->get_pid()
+                 << " " << process->get_creation_time()
+                 << " " << start
+                 << " " << end
+                 << " " << turnaround
+                 << " " << process->get_waiting_time()
+                 << " " << process->get_context_changes() << "\n";
+            Connection& connection = connections[fd->second];
+            connection.output += line.str();
+            connection.unfinished--;
+        }
+        jobs.erase(found);
+        if (process->get_duration())
+            retired.push_back(process);
+        else
+            delete process;
+    }
+
+    // Stops reading from every client while too many processes are live, and
+    // from a single client while its output is not consumed.
+    void update_backpressure() {
+        std::size_t live = jobs.size() + pending.size();
+        if (!reading_paused && live >= max_live)
+            reading_paused = true;
+        else if (reading_paused && live <= max_live / 2)
+            reading_paused = false;
+
+        for (auto& entry : connections) {
+            Connection& connection = entry.second;
+            bool reading = !reading_paused && !connection.closed &&
+                           connection.output.size() < MAX_OUTPUT;
+            if (reading != connection.reading) {
+                connection.reading = reading;
+                rewatch(connection);
+            }
+        }
+    }
+
+    // Also drops the connections that cannot be written, and those closed
+    // by their client once all of their processes are reported.
+    void flush_connections() {
+        std::vector<int> finished;
+        for (auto& entry : connections) {
+            Connection& connection = entry.second;
+            if (!connection.output.empty() && !flush(connection))
+                finished.push_back(entry.first);
+            else if (connection.closed && !connection.unfinished &&
+                     connection.output.empty())
+                finished.push_back(entry.first);
+        }
+        for (int fd : finished)
+            drop(connections[fd]);
+    }
+
+    // Returns false if the connection cannot be written anymore.
+    bool flush(Connection& connection) {
+        std::size_t written = 0;
+        bool good = true;
+        while (written < connection.output.size()) {
+            ssize_t n = write(connection.fd, connection.output.data() + written,
+                              connection.output.size() - written);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0) {
+                good = n < 0 && errno == EAGAIN;
+                break;
+            }
+            written += n;
+        }
+        connection.output.erase(0, written);
+        bool writing = !connection.output.empty();
+        if (writing != connection.writing) {
+            connection.writing = writing;
+            rewatch(connection);
+        }
+        return good;
+    }
+
+    void send_stats() {
+        Clock::time_point now = Clock::now();
+        double seconds = microseconds(last_stats, now) / 1e6;
+        last_stats = now;
+
+        std::ostringstream line;
+        line << "stats time=" << current_time
+             << " live=" << jobs.size() + pending.size()
+             << " admitted=" << admitted
+             << " done=" << completed
+             << " arrivals_per_s=" << (admitted - last_admitted) / seconds
+             << " done_per_s=" << (completed - last_completed) / seconds
+             << " avg_turnaround=" << average(total_turnaround)
+             << " avg_waiting=" << average(total_waiting)
+             << " admission_us_avg=" << admission_latency.average()
+             << " admission_us_p99=" << admission_latency.percentile(0.99)
+             << " admission_us_max=" << admission_latency.get_max()
+             << " dispatch_us_p99=" << dispatch_latency.percentile(0.99)
+             << "\n";
+        last_admitted = admitted;
+        last_completed = completed;
+        for (auto& entry : connections)
+            entry.second.output += line.str();
+    }
+
+    void print_summary() {
+        std::cout << "Processes admitted: " << admitted << std::endl;
+        std::cout << "Processes done: " << completed << std::endl;
+        std::cout << "Average turnaround time: " << average(total_turnaround)
+                  << std::endl;
+        std::cout << "Average waiting time: " << average(total_waiting)
+                  << std::endl;
+        std::cout << "Admission latency p99 (us): "
+                  << admission_latency.percentile(0.99) << std::endl;
+    }
+
+    double average(unsigned long total) const {
+        return completed ? static_cast<double>(total) / completed : 0;
+    }
+
+    static unsigned long microseconds(Clock::time_point from,
+                                      Clock::time_point to) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            to - from).count();
+    }
+};
+
+#endif // DAEMON_H
@@ -0,0 +1,383 @@
+#ifndef EXTERNAL_SORT_H
+#define EXTERNAL_SORT_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <queue>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "arrival_source.h"
+
+/**
+ * @class RunFile
+ * @brief A sorted run of arrivals stored on disk as binary records, read back
+ * through a small buffer. Each record is a fixed size header followed by the
+ * bursts of the process, if it does I/O, and by its group, if any, padded to
+ * a whole word.
+ */
+class RunFile {
+public:
+    struct Record {
+        uint64_t creation_time;
+        uint64_t duration;
+        uint64_t priority;
+        uint64_t burst_count;
+        uint64_t group_length;  // Bytes
+
+        const uint64_t* bursts() const {
+            return reinterpret_cast<const uint64_t*>(this + 1);
+        }
+
+        const char* group() const {
+            return reinterpret_cast<const char*>(bursts() + burst_count);
+        }
+
+        // Size of the header, the bursts and the group, in words.
+        std::size_t words() const {
+            return HEADER_WORDS + burst_count + group_words(group_length);
+        }
+    };
+
+    static std::size_t group_words(std::size_t length) {
+        return (length + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+    }
+
+    static constexpr std::size_t HEADER_WORDS = sizeof(Record) / sizeof(uint64_t);
+
+    RunFile(const std::string& tmp_dir_) :
+        tmp_dir(tmp_dir_), file(nullptr), good(true), position(0) {
+        std::string pattern = tmp_dir + "/scheduler-run-XXXXXX";
+        std::vector<char> name(pattern.begin(), pattern.end());
+        name.push_back('\0');
+        int fd = mkstemp(name.data());
+        if (fd >= 0) {
+            path = name.data();
+            file = fdopen(fd, "w+b");
+        }
+        if (!file) {
+            good = false;
+            cout << "Erro ao criar arquivo temporário em " << tmp_dir << endl;
+        }
+    }
+
+    ~RunFile() {
+        if (file) {
+            fclose(file);
+            unlink(path.c_str());
+        }
+    }
+
+    /**
+     * @return False if the run could not be created or written, so it misses
+     * records.
+     */
+    bool is_good() const {
+        return good;
+    }
+
+    void write(const uint64_t* words, std::size_t count) {
+        if (good && fwrite(words, sizeof(uint64_t), count, file) != count)
+            fail();
+    }
+
+    /**
+     * @brief Goes back to the first record of the run.
+     */
+    void rewind() {
+        if (!file)
+            return;
+        if (good && fflush(file) != 0)
+            fail();
+        fseek(file, 0, SEEK_SET);
+        buffer.clear();
+        position = 0;
+    }
+
+    /**
+     * @return The next record of the run, or nullptr at its end. The record
+     * and its bursts are contiguous in the buffer.
+     */
+    const Record* peek() {
+        if (!fill(HEADER_WORDS))
+            return nullptr;
+        const Record* record = reinterpret_cast<const Record*>(&buffer[position]);
+        if (!fill(record->words()))
+            return nullptr;
+        return reinterpret_cast<const Record*>(&buffer[position]);
+    }
+
+    void pop() {
+        position += reinterpret_cast<const Record*>(&buffer[position])->words();
+    }
+
+private:
+    static constexpr std::size_t BUFFER_WORDS = 4096 * HEADER_WORDS;
+
+    std::string tmp_dir;
+    std::string path;
+    FILE* file;
+    bool good;
+    std::vector<uint64_t> buffer;
+    std::size_t position;
+
+    void fail() {
+        good = false;
+        cout << "Erro ao escrever arquivo temporário em " << tmp_dir << endl;
+    }
+
+    // Makes at least count words available from the position on, moving the
+    // unread words to the front of the buffer before reading more.
+    bool fill(std::size_t count) {
+        if (buffer.size() - position >= count)
+            return true;
+        if (!file)
+            return false;
+        buffer.erase(buffer.begin(), buffer.begin() + position);
+        position = 0;
+        std::size_t unread = buffer.size();
+        buffer.resize(unread + std::max(BUFFER_WORDS, count));
+        buffer.resize(unread + fread(buffer.data() + unread, sizeof(uint64_t),
+                                     buffer.size() - unread, file));
+        return buffer.size() >= count;
+    }
+};
+
+/**
+ * @class ExternalArrivalSource
+ * @brief Yields the arrivals of a workload file that may not fit in memory.
+ *
+ * The file is read in chunks of at most run_records processes. Each chunk is
+ * sorted by creation time and written to a temporary run file. If there are
+ * more runs than MAX_FAN_IN, groups of runs are merged into longer runs first.
+ * The remaining runs are then merged lazily with a k-way merge as the kernel
+ * asks for arrivals, so memory stays bounded by the chunk size plus one
+ * buffer per run. Processes with the same creation time keep the order of the
+ * file.
+ */
+class ExternalArrivalSource : public ArrivalSource {
+public:
+    ExternalArrivalSource(char* file_name,
+                          unsigned long run_records_,
+                          const std::string& tmp_dir_) :
+        run_records(std::max(1ul, run_records_)),
+        tmp_dir(tmp_dir_),
+        total(0),
+        current(0, 0, 0),
+        has_current(false),
+        good(true) {
+        write_runs(file_name);
+        while (good && runs.size() > MAX_FAN_IN)
+            merge_pass();
+        if (good)
+            rewind();
+    }
+
+    ~ExternalArrivalSource() {
+        for (RunFile* run : runs)
+            delete run;
+    }
+
+    const ProcessParams* peek() override {
+        if (!has_current && !heads.empty()) {
+            const RunFile::Record* record = runs[heads.top().run]->peek();
+            current = ProcessParams(record->creation_time,
+                                    record->duration,
+                                    record->priority);
+            bursts.assign(record->bursts(),
+                          record->bursts() + record->burst_count);
+            current.set_bursts(bursts);
+            current.set_group(std::string(record->group(),
+                                          record->group_length));
+            has_current = true;
+        }
+        return has_current ? &current : nullptr;
+    }
+
+    void pop() override {
+        if (heads.empty())
+            return;
+        std::size_t run = heads.top().run;
+        heads.pop();
+        runs[run]->pop();
+        push_head(run);
+        has_current = false;
+    }
+
+    void rewind() override {
+        heads = std::priority_queue<Head, std::vector<Head>, CompareHead>();
+        for (std::size_t run = 0; run < runs.size(); run++) {
+            runs[run]->rewind();
+            push_head(run);
+        }
+        has_current = false;
+    }
+
+    unsigned long size() override {
+        return total;
+    }
+
+    /**
+     * @return False if a run could not be written, so the arrivals would
+     * miss processes and must not be simulated.
+     */
+    bool is_good() const {
+        return good;
+    }
+
+private:
+    static constexpr std::size_t MAX_FAN_IN = 256;
+    static constexpr std::size_t OUTPUT_WORDS = 4096 * RunFile::HEADER_WORDS;
+
+    // The head of a run in the merge. Ties are broken by run index, and runs
+    // are in file order, so equal creation times keep the order of the file.
+    struct Head {
+        uint64_t creation_time;
+        std::size_t run;
+    };
+    struct CompareHead {
+        bool operator()(const Head& lhs, const Head& rhs) const {
+            if (lhs.creation_time != rhs.creation_time)
+                return lhs.creation_time > rhs.creation_time;
+            return lhs.run > rhs.run;
+        }
+    };
+
+    unsigned long run_records;
+    std::string tmp_dir;
+    unsigned long total;
+    std::vector<RunFile*> runs;
+    std::priority_queue<Head, std::vector<Head>, CompareHead> heads;
+    ProcessParams current;
+    std::vector<unsigned long> bursts;
+    bool has_current;
+    bool good;
+
+    // A process of the chunk being read: its creation time and where its
+    // record starts in the words of the chunk.
+    struct ChunkEntry {
+        uint64_t creation_time;
+        std::size_t offset;
+    };
+
+    // Reads the workload in chunks and writes each chunk as a sorted run.
+    void write_runs(char* file_name) {
+        ifstream file(file_name);
+        if (!file.is_open()) {
+            cout << "Erro ao abrir o arquivo!\n";
+            return;
+        }
+
+        std::vector<ChunkEntry> chunk;
+        std::vector<uint64_t> words;
+        chunk.reserve(run_records);
+        ProcessParams params(0, 0, 0);
+        while (good && ProcessParams::read(file, params)) {
+            chunk.push_back({params.get_creation_time(), words.size()});
+            words.push_back(params.get_creation_time());
+            words.push_back(params.get_duration());
+            words.push_back(params.get_priority());
+            words.push_back(params.get_bursts().size());
+            words.push_back(params.get_group().size());
+            words.insert(words.end(), params.get_bursts().begin(),
+                         params.get_bursts().end());
+            std::size_t group_offset = words.size();
+            words.resize(group_offset +
+                         RunFile::group_words(params.get_group().size()));
+            std::memcpy(&words[group_offset], params.get_group().data(),
+                        params.get_group().size());
+            total++;
+            if (chunk.size() == run_records)
+                flush_run(chunk, words);
+        }
+        if (good && !chunk.empty())
+            flush_run(chunk, words);
+    }
+
+    void flush_run(std::vector<ChunkEntry>& chunk, std::vector<uint64_t>& words) {
+        std::stable_sort(chunk.begin(), chunk.end(),
+            [](const ChunkEntry& lhs, const ChunkEntry& rhs) {
+                return lhs.creation_time < rhs.creation_time;
+            });
+        std::vector<uint64_t> sorted;
+        sorted.reserve(words.size());
+        for (const ChunkEntry& entry : chunk) {
+            const RunFile::Record* record =
+                reinterpret_cast<const RunFile::Record*>(&words[entry.offset]);
+            sorted.insert(sorted.end(), &words[entry.offset],
+                          &words[entry.offset] + record->words());
+        }
+        RunFile* run = new RunFile(tmp_dir);
+        run->write(sorted.data(), sorted.size());
+        run->rewind();
+        good = good && run->is_good();
+        runs.push_back(run);
+        chunk.clear();
+        words.clear();
+    }
+
+    // Merges each group of MAX_FAN_IN consecutive runs into a single run,
+    // keeping the runs in file order.
+    void merge_pass() {
+        std::vector<RunFile*> merged_runs;
+        for (std::size_t first = 0; first < runs.size(); first += MAX_FAN_IN) {
+            std::size_t last = std::min(runs.size(), first + MAX_FAN_IN);
+            std::vector<RunFile*> group(runs.begin() + first,
+                                        runs.begin() + last);
+            // After a failure, the remaining runs are only kept to be freed.
+            if (!good) {
+                merged_runs.insert(merged_runs.end(), group.begin(), group.end());
+                continue;
+            }
+            merged_runs.push_back(merge_group(group));
+            for (RunFile* run : group)
+                delete run;
+        }
+        runs = merged_runs;
+    }
+
+    RunFile* merge_group(std::vector<RunFile*>& group) {
+        std::priority_queue<Head, std::vector<Head>, CompareHead> group_heads;
+        for (std::size_t run = 0; run < group.size(); run++) {
+            group[run]->rewind();
+            const RunFile::Record* record = group[run]->peek();
+            if (record)
+                group_heads.push({record->creation_time, run});
+        }
+
+        RunFile* merged = new RunFile(tmp_dir);
+        std::vector<uint64_t> output;
+        output.reserve(OUTPUT_WORDS);
+        while (!group_heads.empty()) {
+            std::size_t run = group_heads.top().run;
+            group_heads.pop();
+            const RunFile::Record* record = group[run]->peek();
+            const uint64_t* first = reinterpret_cast<const uint64_t*>(record);
+            output.insert(output.end(), first, first + record->words());
+            group[run]->pop();
+            record = group[run]->peek();
+            if (record)
+                group_heads.push({record->creation_time, run});
+            if (output.size() >= OUTPUT_WORDS) {
+                merged->write(output.data(), output.size());
+                output.clear();
+            }
+        }
+        merged->write(output.data(), output.size());
+        merged->rewind();
+        good = good && merged->is_good();
+        return merged;
+    }
+
+    void push_head(std::size_t run) {
+        const RunFile::Record* record = runs[run]->peek();
+        if (record)
+            heads.push({record->creation_time, run});
+    }
+};
+
+#endif // EXTERNAL_SORT_H
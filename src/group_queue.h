@@ -0,0 +1,350 @@
+#ifndef GROUP_QUEUE_H
+#define GROUP_QUEUE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "process.h"
+#include "process_queue.h"
+
+/**
+ * @class GroupQueue
+ * @brief Ready queue of a hierarchical fair-share scheduler, in the style of
+ * the cgroup CPU controller.
+ *
+ * Processes belong to groups that form a tree, given by paths such as
+ * /web:3/api, where a group may be followed by its weight (1 by default).
+ * Every group has its own run queue: a binary heap of its runnable children,
+ * processes and groups alike, ordered by virtual runtime, the CPU time they
+ * used divided by their weight. A group is in the run queue of its parent
+ * while it has runnable descendants. The front of the queue is found by
+ * descending from the root to the child with the least virtual runtime at
+ * each level, so siblings share the CPU in proportion to their weights and
+ * processes of the same group share it equally. Pushing, popping and
+ * charging CPU time cost O(depth * log fanout).
+ *
+ * The scheduler charges the CPU time of the running process (see charge);
+ * the queue only orders the runnable entities. An entity that becomes
+ * runnable starts no earlier than the least virtual runtime of its parent's
+ * queue, so a group or process that was idle does not monopolize the CPU
+ * afterwards.
+ */
+class GroupQueue : public ProcessQueueWrapper {
+public:
+    struct Group;
+
+    // A process or a group, as a child of its parent group.
+    struct Entity {
+        uint64_t vruntime;      // CPU time / weight, in 1 / WEIGHT_SCALE s
+        uint64_t sequence;      // Order of the last enqueue, breaks ties
+        unsigned long weight;
+        Group* parent;          // nullptr for the root group
+        std::size_t index;      // Position in the heap of the parent
+        Process* process;       // nullptr for a group
+        Group* group;           // nullptr for a process
+    };
+
+    // The statistics of the processes of a group and its descendants.
+    struct GroupStats {
+        unsigned long processes;
+        unsigned long finished;
+        unsigned long cpu_time;
+        unsigned long waiting_time;
+        unsigned long max_waiting_time;
+        unsigned long turnaround_time;
+    };
+
+    struct Group {
+        Entity entity;
+        std::string path;       // Without the weights
+        unsigned long depth;
+        std::vector<Entity*> heap;
+        uint64_t min_vruntime;
+        std::vector<Group*> children;
+        unsigned long children_weight;
+        GroupStats stats;
+    };
+
+    GroupQueue() : sequence(0), count(0) {
+        root = create_group(nullptr, "/", 1);
+    }
+
+    ~GroupQueue() {
+        for (auto& group : groups)
+            delete group.second;
+    }
+
+    /**
+     * @brief Puts a new process in the group of the given path, creating the
+     * groups that do not exist yet. Weights in the path replace the current
+     * weights of the groups. The root group is the empty path.
+     */
+    void set_group(Process* process, const std::string& path) {
+        Entity& process_entity = entity(process->get_pid());
+        process_entity.process = process;
+        process_entity.parent = find_group(path);
+        for (Group* group = process_entity.parent; group;
+             group = group->entity.parent)
+            group->stats.processes++;
+    }
+
+    void push(Process* process) override {
+        Entity& process_entity = entity(process->get_pid());
+        process_entity.process = process;
+        enqueue(&process_entity);
+        count++;
+    }
+
+    Process* front() override {
+        if (root->heap.empty())
+            return nullptr;
+        Entity* next = root->heap.front();
+        while (next->group)
+            next = next->group->heap.front();
+        return next->process;
+    }
+
+    void pop() override {
+        Process* process = front();
+        if (!process)
+            return;
+        dequeue(&entity(process->get_pid()));
+        count--;
+    }
+
+    bool empty() override {
+        return root->heap.empty();
+    }
+
+    std::size_t size() override {
+        return count;
+    }
+
+    void take_all(std::vector<Process*>& processes) override {
+        for (; !empty(); pop())
+            processes.push_back(front());
+    }
+
+    void copy_to(std::vector<Process*>& processes) override {
+        collect(root, processes);
+    }
+
+    void assign(const std::vector<Process*>& processes) override {
+        std::vector<Process*> queued;
+        take_all(queued);
+        push_range(processes);
+    }
+
+    /**
+     * @brief Adds seconds of CPU time to a process and to the groups above
+     * it, weighted at each level.
+     */
+    void charge(const Process& process, unsigned long seconds) {
+        if (!seconds)
+            return;
+        for (Entity* charged = &entity(process.get_pid()); charged->parent;
+             charged = &charged->parent->entity) {
+            Group* parent = charged->parent;
+            charged->vruntime += seconds * WEIGHT_SCALE / charged->weight;
+            if (charged->index != NOT_QUEUED)
+                sift_down(parent, charged->index);
+            uint64_t least = parent->heap.empty() ?
+                             charged->vruntime :
+                             std::min(charged->vruntime,
+                                      parent->heap.front()->vruntime);
+            parent->min_vruntime = std::max(parent->min_vruntime, least);
+            parent->stats.cpu_time += seconds;
+        }
+    }
+
+    /**
+     * @brief Adds a finished process to the latency statistics of its groups.
+     */
+    void finish(const Process& process, unsigned long current_time) {
+        unsigned long waiting_time = process.get_waiting_time();
+        for (Group* group = entity(process.get_pid()).parent; group;
+             group = group->entity.parent) {
+            group->stats.finished++;
+            group->stats.waiting_time += waiting_time;
+            group->stats.max_waiting_time =
+                std::max(group->stats.max_waiting_time, waiting_time);
+            group->stats.turnaround_time +=
+                current_time - process.get_creation_time();
+        }
+    }
+
+    const Group* get_root() const {
+        return root;
+    }
+
+    std::size_t group_count() const {
+        return groups.size();
+    }
+
+    static constexpr uint64_t WEIGHT_SCALE = 1 << 16;
+
+private:
+    static constexpr std::size_t NOT_QUEUED = SIZE_MAX;
+
+    Group* root;
+    std::unordered_map<std::string, Group*> groups;
+    std::deque<Entity> processes;   // By pid, so pointers stay valid
+    uint64_t sequence;
+    std::size_t count;
+
+    Entity& entity(unsigned long pid) {
+        while (processes.size() <= pid)
+            processes.push_back({0, 0, 1, root, NOT_QUEUED,
+                                 nullptr, nullptr});
+        return processes[pid];
+    }
+
+    Group* create_group(Group* parent, const std::string& path,
+                        unsigned long weight) {
+        Group* group = new Group();
+        group->entity = {0, 0, weight, parent, NOT_QUEUED, nullptr, group};
+        group->path = path;
+        group->depth = parent ? parent->depth + 1 : 0;
+        group->min_vruntime = 0;
+        group->children_weight = 0;
+        group->stats = {0, 0, 0, 0, 0, 0};
+        if (parent) {
+            parent->children.push_back(group);
+            parent->children_weight += weight;
+        }
+        groups[path] = group;
+        return group;
+    }
+
+    // Finds the group of a path, creating it and its ancestors if needed.
+    Group* find_group(const std::string& path) {
+        Group* group = root;
+        std::string group_path;
+        std::size_t begin = 0;
+        while (begin < path.size()) {
+            if (path[begin] == '/') {
+                begin++;
+                continue;
+            }
+            std::size_t end = path.find('/', begin);
+            if (end == std::string::npos)
+                end = path.size();
+            std::string name = path.substr(begin, end - begin);
+            begin = end;
+
+            unsigned long weight = 0;
+            std::size_t colon = name.find(':');
+            if (colon != std::string::npos) {
+                weight = std::strtoul(name.c_str() + colon + 1, nullptr, 10);
+                name.resize(colon);
+            }
+            group_path += "/" + name;
+            auto found = groups.find(group_path);
+            if (found == groups.end()) {
+                group = create_group(group, group_path, weight ? weight : 1);
+            } else {
+                group = found->second;
+                if (weight && weight != group->entity.weight)
+                    set_weight(group, weight);
+            }
+        }
+        return group;
+    }
+
+    void set_weight(Group* group, unsigned long weight) {
+        Group* parent = group->entity.parent;
+        parent->children_weight += weight - group->entity.weight;
+        group->entity.weight = weight;
+    }
+
+    // Makes an entity runnable in its parent, and the parent in its own
+    // parent if it had no runnable child.
+    void enqueue(Entity* queued) {
+        for (; queued->parent; queued = &queued->parent->entity) {
+            Group* parent = queued->parent;
+            bool was_idle = parent->heap.empty();
+            queued->vruntime = std::max(queued->vruntime, parent->min_vruntime);
+            queued->sequence = sequence++;
+            queued->index = parent->heap.size();
+            parent->heap.push_back(queued);
+            sift_up(parent, queued->index);
+            if (!was_idle || parent->entity.index != NOT_QUEUED)
+                break;
+        }
+    }
+
+    // Removes an entity from its parent, and the parent from its own parent
+    // if it has no runnable child left.
+    void dequeue(Entity* queued) {
+        for (; queued->parent; queued = &queued->parent->entity) {
+            Group* parent = queued->parent;
+            std::size_t index = queued->index;
+            queued->index = NOT_QUEUED;
+            Entity* last = parent->heap.back();
+            parent->heap.pop_back();
+            if (last != queued) {
+                parent->heap[index] = last;
+                last->index = index;
+                sift_down(parent, index);
+                sift_up(parent, last->index);
+            }
+            if (!parent->heap.empty() || parent->entity.index == NOT_QUEUED)
+                break;
+        }
+    }
+
+    static bool before(const Entity* lhs, const Entity* rhs) {
+        if (lhs->vruntime != rhs->vruntime)
+            return lhs->vruntime < rhs->vruntime;
+        return lhs->sequence < rhs->sequence;
+    }
+
+    static void place(Group* group, std::size_t index, Entity* placed) {
+        group->heap[index] = placed;
+        placed->index = index;
+    }
+
+    static void sift_up(Group* group, std::size_t index) {
+        Entity* moved = group->heap[index];
+        while (index > 0) {
+            std::size_t parent = (index - 1) / 2;
+            if (!before(moved, group->heap[parent]))
+                break;
+            place(group, index, group->heap[parent]);
+            index = parent;
+        }
+        place(group, index, moved);
+    }
+
+    static void sift_down(Group* group, std::size_t index) {
+        std::vector<Entity*>& heap = group->heap;
+        Entity* moved = heap[index];
+        while (true) {
+            std::size_t child = 2 * index + 1;
+            if (child >= heap.size())
+                break;
+            if (child + 1 < heap.size() && before(heap[child + 1], heap[child]))
+                child++;
+            if (!before(heap[child], moved))
+                break;
+            place(group, index, heap[child]);
+            index = child;
+        }
+        place(group, index, moved);
+    }
+
+    static void collect(const Group* group, std::vector<Process*>& processes) {
+        for (Entity* child : group->heap) {
+            if (child->process)
+                processes.push_back(child->process);
+            else
+                collect(child->group, processes);
+        }
+    }
+};
+
+#endif // GROUP_QUEUE_H
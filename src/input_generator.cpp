@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <cstdlib>
@@ -13,12 +14,20 @@
  * maximum duration of the processes and priority of the processes. The
  * parameters are generated randomly, according to the limits defined in the
  * input arguments.
+ *
+ * With the optional number of bursts, the trace is bursty: a fifth of the
+ * processes arrive uniformly over time, with long durations, and the others
+ * in bursts of short ones, each burst packed in a tenth of the time between
+ * bursts. With the optional number of groups (after the bursts, which may be
+ * 0), each process belongs to one of that many groups, spread over about as
+ * many tenants as groups per tenant, written as /t<tenant>:<weight>/g<group>
+ * with tenant weights from 1 to 4.
  * 
  * @param number_of_processes The number of processes to be generated.
  */
 int main(int argc, char** argv) {
     if (argc < 5) {
-        std::cout << "Usage: ./input_generator <number_of_processes> <max_creation_time> <max_duration> <max_priority>" << std::endl;
+        std::cout << "Usage: ./input_generator <number_of_processes> <max_creation_time> <max_duration> <max_priority> [<bursts> [<groups>]]" << std::endl;
         return 1;
     }
 
@@ -26,20 +35,46 @@ int main(int argc, char** argv) {
     unsigned long max_creation_time = atoi(argv[2]);
     unsigned long max_duration = atoi(argv[3]);
     unsigned long max_priority = atoi(argv[4]);
+    unsigned long bursts = argc > 5 ? atoi(argv[5]) : 0;
+    unsigned long groups = argc > 6 ? atoi(argv[6]) : 0;
+    unsigned long tenants = 1;
+    while ((tenants + 1) * (tenants + 1) <= groups)
+        tenants++;
+    unsigned long tenant_groups = groups ? (groups + tenants - 1) / tenants : 0;
 
     std::ofstream file;
     file.open("input.txt");
 
     srand(time(NULL));
 
-    file    << rand() % max_creation_time << " "
-            << rand() % max_duration +1 << " "
-            << rand() % max_priority;
-    for (unsigned long i = 1; i < number_of_processes; i++) {
-        file    << std::endl
-                << rand() % max_creation_time << " "
-                << rand() % max_duration + 1 << " "
+    unsigned long burst_width = bursts ?
+        std::max(1ul, max_creation_time / (10 * bursts)) : 0;
+    for (unsigned long i = 0; i < number_of_processes; i++) {
+        unsigned long creation_time = rand() % max_creation_time;
+        unsigned long duration = rand() % max_duration + 1;
+        if (bursts) {
+            if (rand() % 5) {
+                // Short process of a burst.
+                unsigned long start = rand() % bursts * max_creation_time /
+                                      bursts;
+                creation_time = start + rand() % burst_width;
+                duration = rand() % std::max(1ul, max_duration / 4) + 1;
+            } else {
+                // Long background process.
+                duration = max_duration / 2 + rand() % (max_duration / 2 + 1);
+                duration = std::max(1ul, duration);
+            }
+        }
+        if (i)
+            file << std::endl;
+        file    << creation_time << " "
+                << duration << " "
                 << rand() % max_priority;
+        if (groups) {
+            unsigned long tenant = rand() % tenants;
+            file << " /t" << tenant << ":" << tenant % 4 + 1
+                 << "/g" << rand() % tenant_groups;
+        }
     }
 
     file.close();
@@ -0,0 +1,1132 @@
+#include "kernel.h"
+
+Kernel::Kernel() :
+    cpu(CPU()),
+    scheduler(nullptr),
+    total_processes(0),
+    process_counter(0),
+    kernel_processes_vector(0),
+    timeline(nullptr),
+    trace(nullptr),
+    live(nullptr),
+    retired(nullptr),
+    arrivals(nullptr),
+    events(nullptr),
+    blocked_count(0),
+    quantum_timer(0),
+    completion_bound(0),
+    preemptions(0),
+    io_workload(false),
+    programs(nullptr),
+    adaptive(nullptr),
+    adaptive_log(nullptr),
+    fair_share(nullptr),
+    snapshot_point(nullptr),
+    resume_point(nullptr) {}
+
+Kernel::Kernel(ArrivalSource* arrivals_, const Options& options_) :
+    cpu(CPU()),
+    scheduler(nullptr),
+    total_processes(0),
+    process_counter(0),
+    kernel_processes_vector(0),
+    options(options_),
+    timeline(nullptr),
+    trace(nullptr),
+    live(nullptr),
+    retired(nullptr),
+    arrivals(arrivals_),
+    events(nullptr),
+    blocked_count(0),
+    quantum_timer(0),
+    completion_bound(0),
+    preemptions(0),
+    io_workload(false),
+    programs(nullptr),
+    adaptive(nullptr),
+    adaptive_log(nullptr),
+    fair_share(nullptr),
+    snapshot_point(nullptr),
+    resume_point(nullptr) {
+        // Incremental runs read the workload on each run, and retiring runs
+        // only keep the processes that are not done.
+        if (!arrivals)
+            return;
+        if (!options.retire)
+            kernel_processes_vector.reserve(arrivals->size());
+        #ifdef COMPACT_PROCESS
+        Process::reserve(arrivals->size());
+        #endif
+    }
+
+Kernel::~Kernel() {
+    delete trace;
+    delete live;
+}
+
+bool Kernel::start_scheduler(unsigned long scheduler_type, unsigned long quantum) {
+
+    total_processes = arrivals->size();
+
+    // Initializes the scheduler according to the scheduler type.
+    create_scheduler(scheduler_type, quantum);
+
+    // The compact layout keeps the statistics of every pid in a table anyway.
+    #ifndef COMPACT_PROCESS
+    if (options.retire) {
+        if (options.timeline != TIMELINE_NONE || !options.program.empty() ||
+            options.analytic == ANALYTIC_CHECK) {
+            std::cout << "Erro: --retire precisa de --timeline=none e não "
+                         "aceita --program nem --analytic=check" << std::endl;
+            reset_scheduler();
+            return false;
+        }
+        retired = new RetiredProcesses(options.tmp_dir);
+        if (!retired->is_open()) {
+            reset_scheduler();
+            return false;
+        }
+        scheduler->collect_finished();
+    }
+    #endif
+
+    // Every run is streamed to the same trace file, one after the other.
+    if (!options.trace_file.empty()) {
+        if (!trace)
+            trace = new TraceWriter(options.trace_file, options.trace_format);
+        trace->begin_run(SchedulerFactory().get_name(scheduler_type));
+        scheduler->set_observer(trace);
+    }
+    if (options.live) {
+        if (!live)
+            live = new LiveMetrics();
+        live->begin_run(scheduler_type, quantum);
+    }
+
+    // Policies without preemption can be computed from the arrivals alone,
+    // without simulating every second, unless switches cost time.
+    bool analytic = options.analytic != ANALYTIC_OFF &&
+                    !scheduler->is_preemptive() && !cpu.has_switch_cost();
+    std::vector<ProcessRecord> analytic_records;
+    if (analytic) {
+        simulate_analytic();
+        if (options.analytic == ANALYTIC_CHECK) {
+            for (Process* process : kernel_processes_vector)
+                analytic_records.push_back(record(process));
+            reset_scheduler();
+            create_scheduler(scheduler_type, quantum);
+            simulate();
+        }
+    } else if (!retired && can_simulate_parallel(scheduler_type)) {
+        simulate_parallel(scheduler_type, quantum);
+    } else {
+        simulate();
+    }
+
+    #ifndef DEBUG
+    // Waits for the timeline to be written before printing the statistics.
+    if (timeline)
+        timeline->close();
+    #endif
+    if (end_failed_run())
+        return false;
+
+    #ifndef DEBUG
+    print_statistics();
+    if (options.analytic == ANALYTIC_CHECK && analytic)
+        check_analytic(analytic_records);
+    scheduler->print_report();
+    cpu.print_report();
+    #endif
+    reset_scheduler();
+    return true;
+}
+
+void Kernel::start_incremental(unsigned long scheduler_type,
+                               unsigned long quantum,
+                               const std::string& file_name) {
+    if (!options.program.empty() || !options.adaptive_log.empty()) {
+        std::cout << "Erro: --incremental não aceita --program nem "
+                     "--adaptive-log" << std::endl;
+        return;
+    }
+    if (scheduler_type == FAIR_SHARE) {
+        std::cout << "Erro: --incremental não aceita o escalonador fair share"
+                  << std::endl;
+        return;
+    }
+    if (options.switch_cost > 0 || options.cache_refill > 0) {
+        std::cout << "Erro: --incremental não aceita --switch-cost"
+                  << std::endl;
+        return;
+    }
+
+    create_scheduler(scheduler_type, quantum);
+    SnapshotPoint point = {file_name,
+                           file_name + ".snapshot-" +
+                           std::to_string(scheduler_type) + "-" +
+                           std::to_string(quantum),
+                           scheduler_type, quantum, ULONG_MAX, 0};
+
+    // Without a snapshot of this file, the whole file is simulated.
+    uint64_t offset = 0;
+    bool resumed = false;
+    SnapshotFile previous(point.path, false);
+    if (previous.good()) {
+        resumed = restore_snapshot(previous, point, offset);
+        if (!resumed) {
+            delete resume_point;
+            resume_point = nullptr;
+            reset_scheduler();
+            create_scheduler(scheduler_type, quantum);
+            io_workload = false;
+            offset = 0;
+        }
+    }
+    previous.close();
+
+    // The processes are retired as they are done, to a file kept next to the
+    // snapshot that holds the records of the processes done before it.
+    retired = new RetiredProcesses(point.path + ".records", !resumed);
+    if (!retired->is_open()) {
+        delete resume_point;
+        resume_point = nullptr;
+        reset_scheduler();
+        return;
+    }
+    scheduler->collect_finished();
+
+    TraceArrivalSource source(file_name, offset, process_counter);
+    if (!source.is_sorted()) {
+        std::cout << "Erro: o modo incremental precisa de um arquivo "
+                     "ordenado pelo tempo de criação" << std::endl;
+        delete resume_point;
+        resume_point = nullptr;
+        reset_scheduler();
+        return;
+    }
+    arrivals = &source;
+    total_processes = source.size();
+    #ifdef COMPACT_PROCESS
+    Process::reserve(total_processes);
+    #endif
+    point.time = source.last_creation_time();
+    point.offset = source.last_creation_offset();
+    snapshot_point = &point;
+
+    // The restored processes are retired by the run, as the ones it creates.
+    kernel_processes_vector.clear();
+    simulate();
+    snapshot_point = nullptr;
+    if (end_failed_run()) {
+        arrivals = nullptr;
+        return;
+    }
+
+    #ifndef DEBUG
+    print_statistics();
+    scheduler->print_report();
+    #endif
+    reset_scheduler();
+    arrivals = nullptr;
+}
+
+void Kernel::start_diff(unsigned long type_a, unsigned long quantum_a,
+                        unsigned long type_b, unsigned long quantum_b) {
+    RunDiff diff(options.tmp_dir);
+    if (!diff.is_open())
+        return;
+
+    total_processes = arrivals->size();
+    create_scheduler(type_a, quantum_a);
+    scheduler->set_observer(&diff);
+    simulate();
+    if (end_failed_run())
+        return;
+    reset_scheduler();
+
+    // A log that misses transitions would report differences that are not.
+    diff.start_second_run();
+    if (!diff.is_good()) {
+        std::cout << "Erro ao escrever arquivo temporário em "
+                  << options.tmp_dir << std::endl;
+        return;
+    }
+    create_scheduler(type_b, quantum_b);
+    scheduler->set_observer(&diff);
+    simulate();
+    if (end_failed_run())
+        return;
+    diff.end_second_run();
+    reset_scheduler();
+
+    auto name = [](unsigned long type, unsigned long quantum) {
+        std::string text = SchedulerFactory().get_name(type);
+        if (type >= RR)
+            text += " (quantum " + std::to_string(quantum) + ")";
+        return text;
+    };
+    diff.print_report(name(type_a, quantum_a), name(type_b, quantum_b));
+}
+
+bool Kernel::simulate_records(unsigned long scheduler_type,
+                              unsigned long quantum,
+                              std::vector<ProcessRecord>& records) {
+    total_processes = arrivals->size();
+    create_scheduler(scheduler_type, quantum);
+    simulate();
+    if (end_failed_run())
+        return false;
+    for (Process* process : kernel_processes_vector)
+        records.push_back(record(process));
+    reset_scheduler();
+    return true;
+}
+
+void Kernel::simulate_result(unsigned long scheduler_type,
+                             unsigned long quantum,
+                             TransitionObserver* observer,
+                             SimulationResult& result) {
+    total_processes = arrivals->size();
+    create_scheduler(scheduler_type, quantum);
+    if (observer)
+        scheduler->set_observer(observer);
+
+    // The spans of a parallel run would notify the observer from several
+    // threads, out of order.
+    bool analytic = options.analytic != ANALYTIC_OFF &&
+                    !scheduler->is_preemptive() && !cpu.has_switch_cost();
+    bool parallel = !observer && can_simulate_parallel(scheduler_type);
+    if (analytic)
+        simulate_analytic();
+    else if (parallel)
+        simulate_parallel(scheduler_type, quantum);
+    else
+        simulate();
+
+    result = SimulationResult();
+    if (!error.empty()) {
+        result.error = error;
+        reset_scheduler();
+        return;
+    }
+    result.processes.reserve(kernel_processes_vector.size());
+    for (Process* process : kernel_processes_vector) {
+        result.processes.push_back(record(process));
+        result.total_turnaround_time += process->get_turnaround_time();
+        result.total_waiting_time += process->get_waiting_time();
+        result.total_io_time += process->get_io_time();
+        result.context_changes += process->get_context_changes();
+        result.makespan = std::max(result.makespan, process->get_end());
+    }
+    result.preemptions = preemptions;
+    reset_scheduler();
+}
+
+unsigned long Kernel::simulate_span(unsigned long scheduler_type,
+                                    unsigned long quantum,
+                                    std::vector<Process*>& processes) {
+    total_processes = arrivals->size();
+    create_scheduler(scheduler_type, quantum);
+    if (const ProcessParams* first = arrivals->peek())
+        resume_point = new ResumePoint{first->get_creation_time(), 0, {}};
+    quantum_timer = 0;
+    simulate();
+    processes.insert(processes.end(), kernel_processes_vector.begin(),
+                     kernel_processes_vector.end());
+    kernel_processes_vector.clear();
+    unsigned long span_preemptions = preemptions;
+    reset_scheduler();
+    return span_preemptions;
+}
+
+bool Kernel::can_simulate_parallel(unsigned long scheduler_type) const {
+    #if defined(DEBUG) || defined(COMPACT_PROCESS)
+    // The debug output is written as the simulation goes, and the compact
+    // layout keeps the processes in tables shared by every kernel.
+    UNUSED(scheduler_type);
+    return false;
+    #else
+    return options.parallel > 1 && scheduler_type >= FCFS &&
+           scheduler_type <= RR && options.program.empty() && !options.aging &&
+           !cpu.has_switch_cost() && options.trace_file.empty() &&
+           !options.live && options.timeline == TIMELINE_NONE &&
+           !options.run_records;
+    #endif
+}
+
+void Kernel::simulate_parallel(unsigned long scheduler_type,
+                               unsigned long quantum) {
+    // Copies the workload, so the spans can be read concurrently, and finds
+    // where the system is idle: before a process created after the time
+    // every earlier process is done by. Processes without duration are
+    // never scheduled, so they take no time.
+    std::vector<ProcessParams> workload;
+    std::vector<std::size_t> idle_starts;
+    workload.reserve(total_processes);
+    unsigned long done_by = 0;
+    for (const ProcessParams* params; (params = arrivals->peek());
+         arrivals->pop()) {
+        if (!params->get_bursts().empty())
+            break;
+        if (params->get_duration()) {
+            if (params->get_creation_time() > done_by && !workload.empty())
+                idle_starts.push_back(workload.size());
+            done_by = std::max(done_by, params->get_creation_time()) +
+                      params->get_duration();
+        }
+        workload.push_back(*params);
+    }
+    if (arrivals->peek() || idle_starts.empty()) {
+        arrivals->rewind();
+        simulate();
+        return;
+    }
+
+    // Cuts the workload at the idle starts into spans of at least its size
+    // over SPANS_PER_THREAD spans per thread, so threads that finish early
+    // take the next span.
+    std::vector<std::size_t> span_starts = {0};
+    std::size_t span_size = workload.size() /
+                            (options.parallel * SPANS_PER_THREAD);
+    for (std::size_t start : idle_starts) {
+        if (start - span_starts.back() >= span_size)
+            span_starts.push_back(start);
+    }
+    span_starts.push_back(workload.size());
+
+    std::vector<std::vector<Process*>> spans(span_starts.size() - 1);
+    std::vector<unsigned long> span_preemptions(spans.size());
+    std::atomic<std::size_t> next_span(0);
+    Options span_options = options;
+    span_options.parallel = 0;
+    auto simulate_spans = [&]() {
+        std::size_t span;
+        while ((span = next_span.fetch_add(1)) < spans.size()) {
+            SpanArrivalSource source(workload.data() + span_starts[span],
+                                     workload.data() + span_starts[span + 1]);
+            Kernel kernel(&source, span_options);
+            span_preemptions[span] = kernel.simulate_span(scheduler_type,
+                                                          quantum,
+                                                          spans[span]);
+        }
+    };
+    std::vector<std::thread> threads;
+    std::size_t thread_count = std::min<std::size_t>(options.parallel,
+                                                     spans.size());
+    for (std::size_t i = 0; i < thread_count; i++)
+        threads.emplace_back(simulate_spans);
+    for (std::thread& thread : threads)
+        thread.join();
+
+    for (std::size_t span = 0; span < spans.size(); span++) {
+        kernel_processes_vector.insert(kernel_processes_vector.end(),
+                                       spans[span].begin(), spans[span].end());
+        preemptions += span_preemptions[span];
+    }
+    process_counter = kernel_processes_vector.size();
+}
+
+void Kernel::save_snapshot(unsigned long current_time, unsigned long ran_pid) {
+    const SnapshotPoint& point = *snapshot_point;
+    ResultHasher prefix;
+    if (!prefix.update_file(point.file_name, point.offset))
+        return;
+    ResultKey key = prefix.key();
+
+    std::string temporary = point.path + ".tmp";
+    SnapshotFile snapshot(temporary, true);
+    snapshot.put(SNAPSHOT_MAGIC);
+    snapshot.put(SNAPSHOT_VERSION);
+    snapshot.put(point.scheduler_type);
+    snapshot.put(point.quantum);
+    snapshot.put(options.adaptive_window);
+    snapshot.put(options.stride);
+    snapshot.put(options.aging);
+    snapshot.put(options.aging_period);
+    snapshot.put(options.pairing_heap);
+    snapshot.put(point.offset);
+    snapshot.put(key.hash);
+    snapshot.put(key.check);
+
+    snapshot.put(current_time);
+    snapshot.put(ran_pid);
+    snapshot.put(process_counter);
+    snapshot.put(blocked_count);
+    snapshot.put(quantum_timer);
+    snapshot.put(completion_bound);
+    snapshot.put(io_workload);
+
+    // The processes that are done are already in the retired processes, so
+    // only the scheduled ones and the ones waiting for I/O are saved.
+    retired->flush();
+    std::vector<Process*> live;
+    scheduler->copy_scheduled(live);
+    std::vector<std::pair<unsigned long, KernelEvent>> pending;
+    events->for_each([&](unsigned long time, const KernelEvent& event) {
+        if (event.type == ARRIVAL_EVENT)
+            return;
+        pending.push_back({time, event});
+        if (event.type == IO_EVENT)
+            live.push_back(event.process);
+    });
+    std::sort(live.begin(), live.end(), [](Process* a, Process* b) {
+        return a->get_pid() < b->get_pid();
+    });
+    snapshot.put(live.size());
+    for (Process* process : live)
+        snapshot.put(process->get_snapshot());
+    scheduler->save(snapshot);
+
+    snapshot.put(pending.size());
+    for (const auto& event : pending) {
+        snapshot.put(event.first);
+        snapshot.put(event.second.type);
+        snapshot.put(event.second.process ?
+                     event.second.process->get_pid() : 0);
+    }
+
+    // The previous snapshot is only replaced by a complete one, taken once
+    // the records of the processes done before it are written.
+    if (!snapshot.close() || !retired->is_good() ||
+        std::rename(temporary.c_str(), point.path.c_str()) != 0) {
+        std::cout << "Erro ao gravar o snapshot " << point.path << std::endl;
+        std::remove(temporary.c_str());
+    }
+}
+
+bool Kernel::restore_snapshot(SnapshotFile& snapshot,
+                              const SnapshotPoint& point,
+                              uint64_t& offset) {
+    if (snapshot.get() != SNAPSHOT_MAGIC ||
+        snapshot.get() != SNAPSHOT_VERSION ||
+        snapshot.get() != point.scheduler_type ||
+        snapshot.get() != point.quantum ||
+        snapshot.get() != options.adaptive_window ||
+        snapshot.get() != options.stride ||
+        snapshot.get() != options.aging ||
+        snapshot.get() != options.aging_period ||
+        snapshot.get() != options.pairing_heap)
+        return false;
+    offset = snapshot.get();
+    ResultKey key;
+    key.hash = snapshot.get();
+    key.check = snapshot.get();
+    ResultHasher prefix;
+    if (!snapshot.good() || !prefix.update_file(point.file_name, offset) ||
+        prefix.key().hash != key.hash || prefix.key().check != key.check)
+        return false;
+
+    resume_point = new ResumePoint();
+    resume_point->time = snapshot.get();
+    resume_point->ran_pid = snapshot.get();
+    process_counter = snapshot.get();
+    blocked_count = snapshot.get();
+    quantum_timer = snapshot.get();
+    completion_bound = snapshot.get();
+    io_workload = snapshot.get();
+    // Each line of the file has at least six bytes. The processes are in
+    // pid order.
+    uint64_t live = snapshot.get();
+    if (process_counter > offset / 6 + 1 || live > process_counter)
+        return false;
+    std::unordered_map<unsigned long, Process*> processes;
+    ProcessSnapshot state;
+    for (uint64_t i = 0; i < live; i++) {
+        snapshot.get(state);
+        if (!snapshot.good() || !state.pid || state.pid > process_counter ||
+            (!kernel_processes_vector.empty() &&
+             state.pid <= kernel_processes_vector.back()->get_pid()))
+            return false;
+        kernel_processes_vector.push_back(new Process(state));
+        processes[state.pid] = kernel_processes_vector.back();
+    }
+    if (!scheduler->restore(snapshot, processes))
+        return false;
+
+    uint64_t count = snapshot.get();
+    for (uint64_t i = 0; i < count && snapshot.good(); i++) {
+        unsigned long time = snapshot.get();
+        KernelEvent event = {snapshot.get(), nullptr};
+        uint64_t pid = snapshot.get();
+        auto process = processes.find(pid);
+        if (event.type == ARRIVAL_EVENT || event.type > REVIEW_EVENT ||
+            (pid && process == processes.end()) ||
+            (event.type == IO_EVENT && !pid))
+            return false;
+        if (pid)
+            event.process = process->second;
+        resume_point->events.push_back({time, event});
+    }
+    return snapshot.good();
+}
+
+void Kernel::simulate() {
+    unsigned long current_time = resume_point ? resume_point->time : 0;
+    unsigned long ran_pid = resume_point ? resume_point->ran_pid : 0;
+
+    bool running = process_counter < total_processes;
+
+    if (running)
+        setup_print();
+
+    events = new TimingWheel<KernelEvent>();
+    schedule_next_arrival();
+    if (resume_point) {
+        for (const auto& event : resume_point->events)
+            events->schedule(event.first, event.second);
+        delete resume_point;
+        resume_point = nullptr;
+    } else {
+        quantum_timer = 0;
+        if (adaptive)
+            events->schedule(adaptive->get_window(), {REVIEW_EVENT, nullptr});
+    }
+
+    // Simulates the system running for each second.
+    while (running) {
+        if (live && live->due())
+            publish_live(current_time, LIVE_RUNNING);
+
+        // The snapshot of an incremental run is the state right before the
+        // last processes of the file are created.
+        if (snapshot_point && current_time == snapshot_point->time)
+            save_snapshot(current_time, ran_pid);
+
+        // Handles the events due now. Only they can lead to a preemption, so
+        // the scheduler is only asked then.
+        bool check_preemption = handle_events(current_time);
+        check_preemption |= create_children(current_time);
+
+        // If the scheduler has preemption, handles it.
+        if (check_preemption && scheduler->has_preemption(current_time)) {
+            cpu.handle_preemption(ran_pid,
+                                    scheduler->get_current_pid());
+            preemptions++;
+        }
+
+        // Runs the scheduler for one second, or in stride mode for a whole
+        // slice that ends at the latest right before the next event. With a
+        // switch cost, the CPU may spend the second switching to the process
+        // dispatched instead.
+        unsigned long seconds = 1;
+        scheduler->end_burst(current_time);
+        bool created = create_children(current_time);
+        ran_pid = scheduler->dispatch(current_time);
+        bool switching = ran_pid && cpu.switch_to(ran_pid, current_time);
+        if (ran_pid && !switching)
+            scheduler->execute();
+        block_processes(current_time);
+        if (retired)
+            retire_processes();
+
+        // Children spawned or a priority changed on the CPU are only seen
+        // by has_preemption at the next second.
+        if (programs && (programs->take_priority_change() || created))
+            events->schedule(current_time + 1, {CHECK_EVENT, nullptr});
+
+        if (ran_pid && options.stride && !switching) {
+            unsigned long next_event = events->next_expiry();
+            seconds += scheduler->extend(current_time,
+                                         next_event == ULONG_MAX ?
+                                         ULONG_MAX :
+                                         next_event - current_time - 1);
+        }
+        if (ran_pid) {
+            cpu.process(ran_pid);
+            cpu.account(ran_pid, current_time, seconds, switching);
+        }
+        #ifndef DEBUG
+        // No process changes state during a slice. The seconds in which the
+        // CPU is idle are only printed while processes wait for I/O.
+        if (ran_pid || blocked_count) {
+            for (unsigned long i = 0; i < seconds; i++)
+                print_schedule(current_time + i, switching ? ran_pid : 0);
+        }
+        #endif
+
+        current_time += seconds;
+        running = error.empty() &&
+                  (ran_pid || process_counter < total_processes ||
+                   blocked_count);
+
+        // Arms the quantum timer of the running process, unless an earlier
+        // one is still pending. The horizon of an aging queue shrinks when a
+        // process of higher priority arrives, so the timer may be rearmed
+        // earlier. A process the CPU is still switching to has not started
+        // its quantum yet.
+        if (ran_pid && !switching) {
+            unsigned long horizon = scheduler->preemption_horizon(current_time);
+            if (horizon != ULONG_MAX && (quantum_timer < current_time ||
+                                         current_time + horizon < quantum_timer)) {
+                quantum_timer = current_time + horizon;
+                events->schedule(quantum_timer, {QUANTUM_EVENT, nullptr});
+            }
+        }
+
+        // Skips the seconds in which the CPU would stay idle.
+        if (options.stride && !ran_pid && running) {
+            unsigned long next_event = events->next_expiry();
+            #ifndef DEBUG
+            if (blocked_count) {
+                for (; current_time < next_event; current_time++)
+                    print_schedule(current_time);
+            }
+            #endif
+            current_time = next_event;
+        }
+    }
+    if (live)
+        publish_live(current_time, LIVE_DONE);
+
+    delete events;
+    events = nullptr;
+}
+
+Process* Kernel::new_process(unsigned long pid,
+                             unsigned long duration,
+                             unsigned long priority,
+                             unsigned long creation_time) {
+    if (free_processes.empty())
+        return new Process(pid, duration, priority, creation_time);
+    Process* process = free_processes.back();
+    free_processes.pop_back();
+    *process = Process(pid, duration, priority, creation_time);
+    return process;
+}
+
+void Kernel::retire_process(Process* process) {
+    retired->write(process->get_pid(), record(process));
+    cpu.release(process->get_pid());
+    free_processes.push_back(process);
+}
+
+void Kernel::retire_processes() {
+    scheduler->take_finished(finished);
+    for (Process* process : finished)
+        retire_process(process);
+    finished.clear();
+}
+
+void Kernel::publish_live(unsigned long current_time, unsigned long state) {
+    const Scheduler::Totals& totals = scheduler->get_totals();
+    LiveCounters counters = {0, state, 0, 0, 0, current_time, 0,
+                             scheduler->ready_size(), total_processes,
+                             process_counter, totals.finished,
+                             totals.turnaround_time, totals.waiting_time,
+                             preemptions};
+    live->publish(counters);
+}
+
+void Kernel::schedule_next_arrival() {
+    const ProcessParams* params = arrivals->peek();
+    if (params)
+        events->schedule(params->get_creation_time(), {ARRIVAL_EVENT, nullptr});
+}
+
+bool Kernel::handle_events(unsigned long current_time) {
+    bool handled = false;
+    unsigned long time;
+    while ((time = events->next_expiry()) <= current_time) {
+        expired_events.clear();
+        events->advance(time, expired_events);
+
+        // The wheel does not order events due at the same time, so arrivals
+        // are handled first and then I/O completions in pid order.
+        std::sort(expired_events.begin(), expired_events.end(),
+            [](const KernelEvent& lhs, const KernelEvent& rhs) {
+                if (lhs.type != rhs.type)
+                    return lhs.type < rhs.type;
+                return lhs.process && rhs.process &&
+                       lhs.process->get_pid() < rhs.process->get_pid();
+            });
+        for (const KernelEvent& event : expired_events) {
+            if (event.type == ARRIVAL_EVENT) {
+                // Creates the processes that are ready to be processed.
+                // A run that stopped early creates no more processes.
+                scheduler->feed(create_processes(time), time);
+                if (error.empty())
+                    schedule_next_arrival();
+            } else if (event.type == IO_EVENT) {
+                blocked_count--;
+                if (programs) {
+                    resume_program(event.process, time);
+                } else {
+                    event.process->next_cpu_burst();
+                    scheduler->feed({event.process}, time);
+                }
+            } else if (event.type == REVIEW_EVENT) {
+                // has_preemption reviews the discipline of the adaptive
+                // scheduler right after the events.
+                events->schedule(time + adaptive->get_window(),
+                                 {REVIEW_EVENT, nullptr});
+            }
+        }
+        handled = true;
+    }
+    return handled;
+}
+
+void Kernel::block_processes(unsigned long current_time) {
+    scheduler->take_blocked(blocked);
+    for (Process* process : blocked) {
+        unsigned long io_duration = programs ?
+                                    programs->io_duration(process) :
+                                    process->get_io_duration();
+        events->schedule(current_time + io_duration, {IO_EVENT, process});
+        blocked_count++;
+    }
+}
+
+void Kernel::create_scheduler(unsigned long scheduler_type,
+                              unsigned long quantum) {
+    scheduler = SchedulerFactory().create_scheduler(scheduler_type, quantum);
+    create_programs();
+    cpu.set_switch_cost(SwitchCost(options.switch_cost, options.cache_refill,
+                                   options.cache_half_life));
+    if (scheduler_type == FAIR_SHARE)
+        fair_share = static_cast<FairShareScheduler*>(scheduler);
+    if (options.pairing_heap)
+        scheduler->set_pairing_heap();
+    if (options.aging && (scheduler_type == PNP || scheduler_type == PP))
+        static_cast<PNPScheduler*>(scheduler)->set_aging(options.aging_period);
+    if (scheduler_type != ADAPTIVE)
+        return;
+    adaptive = static_cast<AdaptiveScheduler*>(scheduler);
+    adaptive->set_window(options.adaptive_window);
+    if (!options.adaptive_log.empty()) {
+        adaptive_log = new std::ofstream(options.adaptive_log);
+        if (!*adaptive_log)
+            std::cout << "Erro ao criar o arquivo " << options.adaptive_log
+                      << std::endl;
+        adaptive->set_log(adaptive_log);
+    }
+}
+
+void Kernel::create_programs() {
+    if (options.program.empty())
+        return;
+    programs = new ProgramRunner();
+    scheduler->set_burst_observer(programs);
+}
+
+void Kernel::resume_program(Process* process, unsigned long current_time) {
+    switch (programs->resume(process)) {
+    case ProgramRunner::STEP_COMPUTE:
+        scheduler->feed({process}, current_time);
+        break;
+    case ProgramRunner::STEP_IO:
+        // A process that does I/O again right after its I/O stays blocked.
+        if (process->get_state_id() != BLOCKED)
+            scheduler->block(process, current_time);
+        events->schedule(current_time + programs->io_duration(process),
+                         {IO_EVENT, process});
+        blocked_count++;
+        break;
+    default:
+        scheduler->retire(process, current_time);
+        break;
+    }
+}
+
+bool Kernel::create_children(unsigned long current_time) {
+    if (!programs)
+        return false;
+    bool created = false;
+    programs->take_spawned(children);
+    while (!children.empty()) {
+        for (ProgramRunner::Child& child : children) {
+            Process* process = new Process(kernel_processes_vector.size() + 1,
+                                           0,
+                                           child.priority,
+                                           current_time);
+            kernel_processes_vector.push_back(process);
+            if (timeline)
+                timeline->track(process);
+            if (fair_share)
+                fair_share->set_group(process, "");
+            programs->attach(process, child.handle);
+            resume_program(process, current_time);
+        }
+        created = true;
+        programs->take_spawned(children);
+    }
+    return created;
+}
+
+void Kernel::simulate_analytic() {
+    unsigned long current_time = 0;
+
+    events = new TimingWheel<KernelEvent>();
+    schedule_next_arrival();
+
+    while (true) {
+        // Feeds every process created or back from I/O up to now at its own
+        // time, so the ready queue sees the same pushes as in simulate().
+        handle_events(current_time);
+        create_children(current_time);
+
+        scheduler->end_burst(current_time);
+        create_children(current_time);
+        unsigned long ran_pid = scheduler->run(current_time);
+        block_processes(current_time);
+        if (retired)
+            retire_processes();
+        if (ran_pid) {
+            // Nothing can take the CPU from the dispatched process, so it runs
+            // to the end of its burst, which the scheduler notices one second
+            // after its last second of execution.
+            cpu.process(ran_pid);
+            Process* process = scheduler->get_current_process();
+            unsigned long remaining = process->get_duration() -
+                                      process->get_total_execution_time();
+            process->run(remaining);
+            current_time += 1 + remaining;
+        } else if (events->next_expiry() != ULONG_MAX) {
+            current_time = events->next_expiry();
+        } else {
+            break;
+        }
+        if (live && live->due())
+            publish_live(current_time, LIVE_RUNNING);
+    }
+    if (live)
+        publish_live(current_time, LIVE_DONE);
+
+    delete events;
+    events = nullptr;
+}
+
+ProcessRecord Kernel::record(const Process* process) {
+    return {process->get_creation_time(),
+            process->get_start(),
+            process->get_end(),
+            process->get_waiting_time(),
+            process->get_context_changes(),
+            process->get_io_time()};
+}
+
+void Kernel::check_analytic(const std::vector<ProcessRecord>& analytic_records) {
+    unsigned long mismatches = 0;
+    for (std::size_t i = 0; i < kernel_processes_vector.size(); i++) {
+        ProcessRecord simulated = record(kernel_processes_vector[i]);
+        const ProcessRecord& computed = analytic_records[i];
+        if (simulated.start == computed.start &&
+            simulated.end == computed.end &&
+            simulated.waiting_time == computed.waiting_time &&
+            simulated.context_changes == computed.context_changes &&
+            simulated.io_time == computed.io_time)
+            continue;
+        if (++mismatches <= 10)
+            std::cout << "P" << i + 1 << ": analytic [start " << computed.start
+                      << ", end " << computed.end
+                      << ", WT " << computed.waiting_time
+                      << ", CC " << computed.context_changes
+                      << ", IO " << computed.io_time
+                      << "] simulated [start " << simulated.start
+                      << ", end " << simulated.end
+                      << ", WT " << simulated.waiting_time
+                      << ", CC " << simulated.context_changes
+                      << ", IO " << simulated.io_time << "]"
+                      << std::endl;
+    }
+    if (mismatches)
+        std::cout << "Analytic cross-check: " << mismatches
+                  << " processes differ" << std::endl;
+    else
+        std::cout << "Analytic cross-check: OK ("
+                  << kernel_processes_vector.size() << " processes)" << std::endl;
+}
+
+void Kernel::reset_scheduler() {
+    delete scheduler;
+    scheduler = nullptr;
+    delete programs;
+    programs = nullptr;
+    adaptive = nullptr;
+    delete adaptive_log;
+    adaptive_log = nullptr;
+    fair_share = nullptr;
+    delete timeline;
+    timeline = nullptr;
+    process_counter = 0;
+    blocked_count = 0;
+    completion_bound = 0;
+    preemptions = 0;
+    error.clear();
+    if (arrivals)
+        arrivals->rewind();
+    for (auto process = kernel_processes_vector.begin();
+            process != kernel_processes_vector.end(); ++process)
+        delete *process;
+    kernel_processes_vector.clear();
+    delete retired;
+    retired = nullptr;
+    for (Process* process : free_processes)
+        delete process;
+    free_processes.clear();
+}
+
+bool Kernel::end_failed_run() {
+    if (error.empty())
+        return false;
+    std::cout << error << std::endl;
+    reset_scheduler();
+    return true;
+}
+
+std::vector<Process*> Kernel::create_processes(unsigned long current_time) {
+    std::vector<Process*> new_processes;
+    const ProcessParams* params;
+    while ((params = arrivals->peek()) &&
+           params->get_creation_time() == current_time) {
+        #ifdef COMPACT_PROCESS
+        // Every process created so far ends at the latest at this bound,
+        // which must fit in the 32 bit times of the compact layout.
+        completion_bound = std::max(completion_bound, current_time) +
+                           params->get_duration();
+        for (unsigned long burst : params->get_bursts())
+            completion_bound += burst;
+        if (!Process::fits(completion_bound + 1,
+                           params->get_priority(),
+                           process_counter + 1)) {
+            error = "Erro: P" + std::to_string(process_counter + 1) +
+                    " não cabe no layout compacto (tempos de 32 bits, "
+                    "prioridade de 24 bits)";
+            break;
+        }
+        #endif
+        // Programs spawn children, so pids are given in creation order.
+        // Retiring runs have no programs and keep no processes in the vector.
+        unsigned long pid = retired ? process_counter + 1 :
+                            kernel_processes_vector.size() + 1;
+        Process* new_p = new_process(pid,
+                                     params->get_duration(),
+                                     params->get_priority(),
+                                     current_time);
+        if (!retired)
+            kernel_processes_vector.push_back(new_p);
+        if (fair_share)
+            fair_share->set_group(new_p, params->get_group());
+        if (!params->get_bursts().empty()) {
+            // With programs, the bursts are given to the program instead.
+            if (!programs)
+                new_p->set_bursts(params->get_bursts());
+            io_workload = true;
+        }
+        if (programs) {
+            // The program decides what the process does from its creation.
+            if (timeline)
+                timeline->track(new_p);
+            programs->attach(new_p,
+                             ProgramLibrary::create(options.program, *params));
+            ++process_counter;
+            arrivals->pop();
+            resume_program(new_p, current_time);
+            continue;
+        }
+        if (params->get_duration() > 0) {
+            new_processes.push_back(new_p);
+            if (timeline)
+                timeline->track(new_p);
+        } else if (retired) {
+            // Processes without duration are never scheduled.
+            retire_process(new_p);
+        }
+        ++process_counter;
+        arrivals->pop();
+    }
+    return new_processes;
+}
+
+void Kernel::setup_print() {
+    if (options.timeline == TIMELINE_NONE || options.incremental ||
+        options.diff_type)
+        return;
+    std::cout.flush();
+    timeline = new TimelineRenderer(options, total_processes);
+    timeline->setup();
+    #ifdef DEBUG
+    // The debug trace goes through std::cout, so the header is written right
+    // away to keep it first.
+    timeline->close();
+    #endif
+}
+
+void Kernel::print_schedule(unsigned long current_time,
+                            unsigned long switching_pid) {
+    if (timeline)
+        timeline->render(current_time, kernel_processes_vector,
+                         switching_pid);
+}
+
+void Kernel::print_statistics() {
+    float average_turnaround_time = 0;
+    float average_waiting_time = 0;
+    float average_io_time = 0;
+    unsigned long context_changes = 0;
+
+    std::cout << std::endl;
+    std::cout << "Legenda: " << std::endl;
+    std::cout << setw(2) << "" << "[TT] = Turnaround Time" << std::endl;
+    std::cout << setw(2) << "" << "[WT] = Waiting Time" << std::endl;
+    std::cout << setw(2) << "" << "[CC] = Context Changes" << std::endl;
+    if (io_workload)
+        std::cout << setw(2) << "" << "[IO] = I/O Wait Time" << std::endl;
+    std::cout << std::endl;
+
+    // Programs may have spawned more processes than the workload has. The
+    // statistics of a retiring run are read back from its file.
+    std::size_t process_count = kernel_processes_vector.size();
+    if (retired) {
+        process_count = process_counter;
+        retired->rewind();
+    }
+    std::cout << "Estatísticas: " << std::endl;
+    for (std::size_t i = 0; i < process_count; i++) {
+        ProcessRecord process;
+        if (!retired)
+            process = record(kernel_processes_vector[i]);
+        else if (!retired->read(process))
+            break;
+        average_turnaround_time += process.turnaround_time();
+        average_waiting_time += process.waiting_time;
+        average_io_time += process.io_time;
+        context_changes += process.context_changes;
+
+        std::cout
+        << std::setw(2) << std::right << "" << "P" << i+1 << ":"
+        << std::setw(9) << std::left
+                        << "[TT] "+to_string(process.turnaround_time())
+        << std::setw(9) << std::left
+                        << "[WT] "+to_string(process.waiting_time)
+        << std::setw(9) << std::left
+                        << "[CC] "+to_string(process.context_changes);
+        if (io_workload)
+            std::cout << std::setw(9) << std::left
+                      << "[IO] "+to_string(process.io_time);
+        std::cout << std::endl;
+    }
+    if (retired && !retired->is_good())
+        std::cout << "Erro ao ler ou escrever as estatísticas dos processos "
+                     "terminados" << std::endl;
+    std::cout << std::endl;
+
+    std::cout << "Average turnaround time: "
+        << average_turnaround_time / process_count << std::endl;
+    std::cout << std::endl;
+
+    std::cout << "Average waiting time: "
+        << average_waiting_time / process_count << std::endl;
+    std::cout << std::endl;
+
+    if (io_workload) {
+        std::cout << "Average I/O wait time: "
+            << average_io_time / process_count << std::endl;
+        std::cout << std::endl;
+    }
+
+    std::cout << "Total context changes: " << context_changes << std::endl;
+    std::cout << string(80, '-') << std::endl;
+
+}
\ No newline at end of file
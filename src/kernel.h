@@ -2,12 +2,28 @@
 #define KERNEL_H
 
 #include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 #include <iomanip>
+#include "arrival_source.h"
 #include "cpu.h"
+#include "live_metrics.h"
+#include "options.h"
 #include "scheduler.h"
 #include "process.h"
+#include "programs.h"
 #include "read_file.h"
+#include "result_cache.h"
+#include "retired_processes.h"
+#include "run_diff.h"
+#include "simulation.h"
+#include "snapshot.h"
+#include "timeline.h"
+#include "timing_wheel.h"
 
 /**
  * @class Kernel
@@ -20,7 +36,11 @@ public:
 
     Kernel();
 
-    Kernel(std::vector<ProcessParams *> processes_params);
+    /**
+     * @param arrivals_ The workload, yielded in creation time order. It is not
+     * owned by the kernel.
+     */
+    Kernel(ArrivalSource* arrivals_, const Options& options_ = Options());
 
     ~Kernel();
 
@@ -28,8 +48,72 @@ public:
      * @brief Starts the scheduler. For each second of the system running, 
      * feeds the scheduler with the processes that are ready to enter 
      * scheduling.
+     *
+     * @return False if the run could not be done; the error is printed.
+     */
+    bool start_scheduler(unsigned long scheduler_type, unsigned long quantum);
+
+    /**
+     * @brief Simulates a scheduler on a workload file that only grows by
+     * appending processes created no earlier than the last ones, without a
+     * timeline.
+     *
+     * Each run saves a snapshot of the simulation, next to the file, at the
+     * creation time of its last processes, right before they are created. The
+     * next run resumes from it if the file still starts with the same bytes
+     * up to those processes, and only simulates from there; otherwise it
+     * simulates the whole file. Either way the output is the one of a full
+     * run. The file must be sorted by creation time, and processes created at
+     * the same time run in the order of the file, as with --external-sort.
+     *
+     * The processes are retired as they are done (see Options::retire), to a
+     * file kept next to the snapshot, so a snapshot only holds the processes
+     * that are not done and a resumed run only writes the records of the
+     * processes done after it.
      */
-    void start_scheduler(unsigned long scheduler_type, unsigned long quantum);
+    void start_incremental(unsigned long scheduler_type,
+                           unsigned long quantum,
+                           const std::string& file_name);
+
+    /**
+     * @brief Simulates two schedulers on the workload, one after the other,
+     * and prints how the second run differs from the first (see RunDiff)
+     * instead of their timelines and statistics.
+     */
+    void start_diff(unsigned long type_a, unsigned long quantum_a,
+                    unsigned long type_b, unsigned long quantum_b);
+
+    /**
+     * @brief Simulates the scheduler without printing anything and appends
+     * the statistics of every process, by pid, to records. Used to check
+     * other engines against the simulation.
+     *
+     * @return False if the run stopped early; only its error is printed.
+     */
+    bool simulate_records(unsigned long scheduler_type,
+                          unsigned long quantum,
+                          std::vector<ProcessRecord>& records);
+
+    /**
+     * @brief Simulates the scheduler as start_scheduler does, without
+     * printing anything, and fills result with the statistics (see
+     * simulate_workload), or its error with why the run stopped early. The
+     * observer, if any, gets every transition.
+     */
+    void simulate_result(unsigned long scheduler_type,
+                         unsigned long quantum,
+                         TransitionObserver* observer,
+                         SimulationResult& result);
+
+    /**
+     * @brief Simulates the scheduler on arrivals that find the system idle,
+     * from the first one on, and moves the processes, in pid order, to the
+     * end of processes.
+     * @return The number of preemptions.
+     */
+    unsigned long simulate_span(unsigned long scheduler_type,
+                                unsigned long quantum,
+                                std::vector<Process*>& processes);
 
 private:
     CPU cpu;
@@ -37,13 +121,215 @@ private:
     unsigned long total_processes;
     unsigned long process_counter;
     std::vector<Process*> kernel_processes_vector;
+    Options options;
+    TimelineRenderer* timeline;
+    TraceWriter* trace;
+    LiveMetrics* live;              // Created by the first run with --live
+    RetiredProcesses* retired;      // Set by a run with --retire
+    std::vector<Process*> finished;
+    std::vector<Process*> free_processes;   // Retired, to be reused
+    ArrivalSource* arrivals;
+
+    // Time based events of a simulation. Only the next arrival is in the
+    // wheel, as the arrival source is already in creation time order.
+    enum EventType {
+        ARRIVAL_EVENT,
+        QUANTUM_EVENT,
+        IO_EVENT,
+        CHECK_EVENT,    // A preemption check after a program changed the ready
+                        // queue or the priority of the running process
+        REVIEW_EVENT    // The end of a window of the adaptive scheduler
+    };
+    struct KernelEvent {
+        unsigned long type;     // EventType
+        Process* process;       // The process whose I/O is done
+    };
+    TimingWheel<KernelEvent>* events;
+    std::vector<KernelEvent> expired_events;
+    std::vector<Process*> blocked;
+    unsigned long blocked_count;
+    unsigned long quantum_timer;
+    unsigned long completion_bound;
+    unsigned long preemptions;
+    std::string error;          // Why the run stopped early, if it did
+    bool io_workload;
+    ProgramRunner* programs;
+    std::vector<ProgramRunner::Child> children;
+    AdaptiveScheduler* adaptive;
+    std::ofstream* adaptive_log;
+    FairShareScheduler* fair_share;
+
+    // Where an incremental run saves its snapshot (see start_incremental).
+    struct SnapshotPoint {
+        std::string file_name;          // The workload file
+        std::string path;               // The snapshot file
+        unsigned long scheduler_type;
+        unsigned long quantum;
+        unsigned long time;             // Creation time of the last processes
+        uint64_t offset;                // Offset of the first of them
+    };
+    SnapshotPoint* snapshot_point;
 
-    struct CompareProcessParams {
-        bool operator()(const ProcessParams* lhs, const ProcessParams* rhs) const {
-            return lhs->get_creation_time() < rhs->get_creation_time();
-        }
+    // The state restored from a snapshot that simulate resumes from.
+    struct ResumePoint {
+        unsigned long time;
+        unsigned long ran_pid;
+        std::vector<std::pair<unsigned long, KernelEvent>> events;
     };
-    std::vector<ProcessParams *> params_queue;
+    ResumePoint* resume_point;
+
+    static constexpr uint64_t SNAPSHOT_MAGIC = 0x70616e73746e6e73ull;
+    static constexpr uint64_t SNAPSHOT_VERSION = 4;
+
+    // Spans of a parallel simulation per thread (see simulate_parallel).
+    static constexpr std::size_t SPANS_PER_THREAD = 8;
+
+    /**
+     * @brief Simulates the current scheduler one second at a time, printing
+     * the timeline. Arrivals, quantum expiries and I/O completions go through
+     * a timing wheel, so only the seconds with due events create processes or
+     * check for preemption. In stride mode, each call to the scheduler runs a whole
+     * slice, so the cost is proportional to the number of slices.
+     */
+    void simulate();
+
+    /**
+     * @brief Simulates the current scheduler as simulate does, on several
+     * threads, for the policies and workloads whose busy periods do not
+     * depend on the policy (see can_simulate_parallel).
+     *
+     * A single CPU that is never idle while a process is ready is busy for
+     * the same periods under every such policy: they only depend on the
+     * arrivals and durations. A process created after every earlier one is
+     * done finds the system idle, as in a fresh run, so the workload is cut
+     * there into spans of roughly equal size, simulated on their own by
+     * kernels on separate threads. The processes are then gathered in pid
+     * order, and the statistics are the same as the ones of simulate.
+     * Workloads with a single busy period are simulated sequentially.
+     */
+    void simulate_parallel(unsigned long scheduler_type, unsigned long quantum);
+
+    /**
+     * @return True if the run can be simulated by simulate_parallel: a
+     * policy from FCFS to Round Robin, which keeps no state across idle
+     * periods, without programs, aging, switch costs, trace or timeline.
+     * The workload must also be in memory, as simulate_parallel copies it
+     * (not with --external-sort), and have no I/O, which simulate_parallel
+     * checks.
+     */
+    bool can_simulate_parallel(unsigned long scheduler_type) const;
+
+    /**
+     * @brief Creates a process, in the memory of a retired one if any.
+     */
+    Process* new_process(unsigned long pid,
+                         unsigned long duration,
+                         unsigned long priority,
+                         unsigned long creation_time);
+
+    /**
+     * @brief Writes the statistics of a process that is done to the retired
+     * processes and keeps its memory for the next process created.
+     */
+    void retire_process(Process* process);
+
+    /**
+     * @brief Retires the processes that are done since the last call (see
+     * Scheduler::collect_finished).
+     */
+    void retire_processes();
+
+    /**
+     * @brief Publishes the counters of the current run (see LiveMetrics).
+     */
+    void publish_live(unsigned long current_time, unsigned long state);
+
+    /**
+     * @brief Schedules the arrival event of the next process of the arrival
+     * source, if any.
+     */
+    void schedule_next_arrival();
+
+    /**
+     * @brief Handles the events due up to the current time, each one at its
+     * own time: creates the arriving processes and feeds the scheduler with
+     * them and with the processes whose I/O is done.
+     * @return True if any event was due.
+     */
+    bool handle_events(unsigned long current_time);
+
+    /**
+     * @brief Schedules the I/O completion of the processes that blocked in
+     * the last run of the scheduler. Blocked processes cost nothing until
+     * then.
+     */
+    void block_processes(unsigned long current_time);
+
+    /**
+     * @brief Creates the program runner of the current scheduler, if the
+     * processes run programs (see Options::program).
+     */
+    void create_programs();
+
+    /**
+     * @brief Creates the scheduler of the given type and what comes with it:
+     * the program runner, the queues and aging of the priority schedulers
+     * and, for the adaptive scheduler, its window and log.
+     */
+    void create_scheduler(unsigned long scheduler_type, unsigned long quantum);
+
+    /**
+     * @brief Writes the snapshot of an incremental run at the top of the
+     * second current_time, before its events are handled. The pending arrival
+     * is not saved, as the arrivals are read again from the file, and neither
+     * are the processes that are done, whose records are in the retired
+     * processes.
+     */
+    void save_snapshot(unsigned long current_time, unsigned long ran_pid);
+
+    /**
+     * @brief Restores the processes that are not done, the scheduler and the
+     * pending events of a snapshot written by save_snapshot for the run of
+     * point. The restored processes are left in kernel_processes_vector.
+     *
+     * @param offset Set to the offset of the first process of the file that
+     * is not restored.
+     * @return False if the snapshot is of another run or of a file that does
+     * not start with the same bytes, or is broken. The caller must then reset
+     * the scheduler.
+     */
+    bool restore_snapshot(SnapshotFile& snapshot,
+                          const SnapshotPoint& point,
+                          uint64_t& offset);
+
+    /**
+     * @brief Resumes the program of a process that is not on the CPU and
+     * feeds, blocks or retires the process according to what it does next.
+     */
+    void resume_program(Process* process, unsigned long current_time);
+
+    /**
+     * @brief Creates the child processes spawned by the programs and starts
+     * their programs.
+     * @return True if any child was created.
+     */
+    bool create_children(unsigned long current_time);
+
+    /**
+     * @brief Computes the schedule of a scheduler without preemption. Each
+     * dispatched process runs to completion in one step, so the cost is
+     * O(n log n) in the number of processes and does not depend on their
+     * durations. No timeline is printed.
+     */
+    void simulate_analytic();
+
+    static ProcessRecord record(const Process* process);
+
+    /**
+     * @brief Compares the statistics of the processes with the ones computed
+     * by simulate_analytic and prints the differences.
+     */
+    void check_analytic(const std::vector<ProcessRecord>& analytic_records);
 
     /**
      * @brief Destroys the current scheduler and resets scheduling related
@@ -52,23 +338,36 @@ private:
     void reset_scheduler();
 
     /**
-     * @brief Goes through the queue of process paramaters and creates the
-     * processes that are ready to be created at the current time.
+     * @brief Prints the error of a run that stopped early, if any, and
+     * resets the scheduler.
+     * @return True if the run stopped early.
+     */
+    bool end_failed_run();
+
+    /**
+     * @brief Pulls from the arrival source the processes that are ready to be
+     * created at the current time and creates them. In the compact build, a
+     * process that does not fit the layout stops the run instead (see
+     * error).
      * @return A vector<Process> containing the processes that were required to
      * be created at the current time.
      */
     std::vector<Process*> create_processes(unsigned long current_time);
 
     /**
-     * @brief Prints the scheduling timeline header.
+     * @brief Prints the scheduling timeline header. From here on the timeline
+     * is written by the TimelineWriter thread, so std::cout is flushed first.
+     * Does nothing if the timeline is disabled.
      */
     void setup_print();
 
     /**
      * @brief Prints the time stamp, followed by the state mneumonic for each
-     * process of the process timeline.
+     * column of the process timeline (see TimelineRenderer). switching_pid,
+     * if not 0, is the process the CPU spends the second switching to.
      */
-    void print_schedule(unsigned long current_time);
+    void print_schedule(unsigned long current_time,
+                        unsigned long switching_pid = 0);
 
     /**
      * @brief Prints the statistics of the scheduling after the simulation is
@@ -87,7 +386,9 @@ enum SchedulerType {
     SJF,
     PNP,
     PP,
-    RR
+    RR,
+    ADAPTIVE,
+    FAIR_SHARE
 };
 
 class SchedulerFactory {
@@ -122,175 +423,40 @@ public:
         case RR:
             return new RRNPScheduler(quantum);
             break;
+        case ADAPTIVE:
+            return new AdaptiveScheduler(quantum);
+            break;
+        case FAIR_SHARE:
+            return new FairShareScheduler(quantum);
+            break;
         default:
             return new FCFScheduler();
             break;
         }
     }
-};
-
-#endif // KERNEL_H
-
-Kernel::Kernel() :
-    cpu(CPU()),
-    scheduler(nullptr),
-    total_processes(0),
-    process_counter(0),
-    kernel_processes_vector(0) {}
-
-Kernel::Kernel(std::vector<ProcessParams *> processes_params) :
-    cpu(CPU()),
-    scheduler(nullptr),
-    total_processes(0),
-    process_counter(0),
-    kernel_processes_vector(0),
-    params_queue(processes_params) {
-        std::sort(
-            params_queue.begin(),
-            params_queue.end(),
-            CompareProcessParams());
-        kernel_processes_vector.reserve(params_queue.size());
-    }
-
-Kernel::~Kernel() {}
-
-void Kernel::start_scheduler(unsigned long scheduler_type, unsigned long quantum) {
-
-    total_processes = params_queue.size();
-    unsigned long current_time = 0;
-    unsigned long ran_pid = 0;
-
-    // Initializes the scheduler according to the scheduler type.
-    scheduler = SchedulerFactory().create_scheduler(scheduler_type, quantum);
-
-    bool running = process_counter < total_processes;
-
-    if (running)
-        setup_print();
-
-    // Simulates the system running for each second.
-    while (running) {
 
-        // Creates a vector of processes that are ready to be processed.
-        std::vector<Process*> new_processes = create_processes(current_time);
-        scheduler->feed(new_processes, current_time);
-
-        // If the scheduler has preemption, handles it.
-        if (scheduler->has_preemption(current_time)) {
-            cpu.handle_preemption(ran_pid,
-                                    scheduler->get_current_pid());
-        }
-
-        // Runs the scheduler for one second.
-        ran_pid = scheduler->run(current_time);
-        if (ran_pid) {
-            cpu.process(ran_pid);
-            #ifndef DEBUG
-            print_schedule(current_time);
-            #endif
-        }
-
-        ++current_time;
-        running = ran_pid || process_counter < total_processes;
-    }
-    #ifndef DEBUG
-    print_statistics();
-    #endif
-    reset_scheduler();
-}
-
-void Kernel::reset_scheduler() {
-    delete scheduler;
-    scheduler = nullptr;
-    process_counter = 0;
-    for (auto process = kernel_processes_vector.begin();
-            process != kernel_processes_vector.end(); ++process)
-        delete *process;
-    kernel_processes_vector.clear();
-}
-
-std::vector<Process*> Kernel::create_processes(unsigned long current_time) {
-    std::vector<Process*> new_processes;
-    while (
-        process_counter < params_queue.size() &&
-        params_queue[process_counter]->get_creation_time() == current_time) {
-        ProcessParams* params = params_queue[process_counter];
-        Process* new_p = new Process((process_counter+1),
-                                 params->get_duration(),
-                                 params->get_priority(),
-                                 current_time);
-        kernel_processes_vector.push_back(new_p);
-        if (params->get_duration() > 0)
-            new_processes.push_back(new_p);
-        ++process_counter;
-    }
-    return new_processes;
-}
-
-void Kernel::setup_print() {
-    std::cout << std::setw(3) << std::right << "" << "tempo"
-            << std::setw(3) << std::left << "";
-    for (std::size_t i = 1; i <= total_processes; i++) {
-        std::string process_code = "P" + std::to_string(i);
-        std::cout << std::setw(4) << std::right << process_code;
-    }
-    std::cout << std::endl;
-}
-
-void Kernel::print_schedule(unsigned long current_time) {
-    std::cout << std::setw(5) << std::right << current_time << "-" << std::setw(5) << std::left << (current_time + 1);
-
-    for (std::size_t i = 1; i <= total_processes; i++) {
-        if (i <= kernel_processes_vector.size()) {
-            std::cout << std::setw(4) << std::right
-            << kernel_processes_vector[i - 1]->get_state();
-        } else {
-            std::cout << std::setw(4) << "  ";
+    /**
+     * @return The name of the scheduler type.
+     */
+    std::string get_name(unsigned long scheduler_type) {
+        switch (scheduler_type)
+        {
+        case SJF:
+            return "Shortest Job First";
+        case PNP:
+            return "Priority, no preemption";
+        case PP:
+            return "Prioity, with preemption";
+        case RR:
+            return "Round Robin";
+        case ADAPTIVE:
+            return "Adaptive";
+        case FAIR_SHARE:
+            return "Fair share";
+        default:
+            return "First Come First Served";
         }
     }
-    std::cout << std::endl;
-}
-
-void Kernel::print_statistics() {
-    float average_turnaround_time = 0;
-    float average_waiting_time = 0;
-    unsigned long context_changes = 0;
-
-    std::cout << std::endl;
-    std::cout << "Legenda: " << std::endl;
-    std::cout << setw(2) << "" << "[TT] = Turnaround Time" << std::endl;
-    std::cout << setw(2) << "" << "[WT] = Waiting Time" << std::endl;
-    std::cout << setw(2) << "" << "[CC] = Context Changes" << std::endl;
-    std::cout << std::endl;
-
-    std::cout << "Estatísticas: " << std::endl;
-    for (std::size_t i = 0; i < total_processes; i++) {
-        Process* process = kernel_processes_vector[i];
-        average_turnaround_time += process->get_turnaround_time();
-        average_waiting_time += process->get_waiting_time();
-        context_changes += process->get_context_changes();
-
-        std::cout
-        << std::setw(2) << std::right << "" << "P" << i+1 << ":"
-        << std::setw(9) << std::left
-                        << "[TT] "+to_string(process->get_turnaround_time())
-        << std::setw(9) << std::left
-                        << "[WT] "+to_string(process->get_waiting_time())
-        << std::setw(9) << std::left
-                        << "[CC] "+to_string(process->get_context_changes())
-        << std::endl;
-    }
-    std::cout << std::endl;
-
-    std::cout << "Average turnaround time: "
-        << average_turnaround_time / total_processes << std::endl;
-    std::cout << std::endl;
-
-    std::cout << "Average waiting time: "
-        << average_waiting_time / total_processes << std::endl;
-    std::cout << std::endl;
-
-    std::cout << "Total context changes: " << context_changes << std::endl;
-    std::cout << string(80, '-') << std::endl;
+};
 
-}
\ No newline at end of file
+#endif // KERNEL_H
@@ -0,0 +1,184 @@
+#ifndef LIVE_METRICS_H
+#define LIVE_METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/**
+ * @brief The counters of a simulation, as published by LiveMetrics.
+ */
+struct LiveCounters {
+    uint64_t pid;                   // Of the simulator
+    uint64_t state;                 // LiveState
+    uint64_t scheduler_type;
+    uint64_t quantum;
+    uint64_t wall_time;             // Nanoseconds since the run started
+    uint64_t simulated_time;
+    uint64_t iterations;            // Of the simulation loop
+    uint64_t ready;                 // Processes in the ready queue
+    uint64_t total_processes;
+    uint64_t created;
+    uint64_t finished;
+    uint64_t turnaround_time;       // Sum over the finished processes
+    uint64_t waiting_time;          // Sum over the finished processes
+    uint64_t preemptions;
+};
+
+enum LiveState {
+    LIVE_RUNNING = 1,
+    LIVE_DONE
+};
+
+/**
+ * @brief The shared memory segment: the counters, guarded by a sequence
+ * number that is odd while they are being written (a seqlock). The counters
+ * are atomics only so a reader may load them while they change; the sequence
+ * number tells it whether it got a consistent copy.
+ */
+struct LiveSegment {
+    static constexpr std::size_t COUNTERS = sizeof(LiveCounters) /
+                                            sizeof(uint64_t);
+
+    uint64_t magic;
+    std::atomic<uint64_t> sequence;
+    std::atomic<uint64_t> counters[COUNTERS];
+
+    static constexpr uint64_t MAGIC = 0x31766c6465686373ull;
+
+    /**
+     * @brief Copies the counters into the segment. Only one process writes
+     * to a segment, so it never waits.
+     */
+    void write(const LiveCounters& values) {
+        uint64_t words[COUNTERS];
+        std::memcpy(words, &values, sizeof(words));
+        uint64_t start = sequence.load(std::memory_order_relaxed);
+        sequence.store(start + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (std::size_t i = 0; i < COUNTERS; i++)
+            counters[i].store(words[i], std::memory_order_relaxed);
+        sequence.store(start + 2, std::memory_order_release);
+    }
+
+    /**
+     * @brief Copies the counters out of the segment, retrying while the
+     * writer changes them.
+     */
+    void read(LiveCounters& values) const {
+        uint64_t words[COUNTERS];
+        while (true) {
+            uint64_t start = sequence.load(std::memory_order_acquire);
+            if (start % 2 == 0) {
+                for (std::size_t i = 0; i < COUNTERS; i++)
+                    words[i] = counters[i].load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (sequence.load(std::memory_order_relaxed) == start)
+                    break;
+            }
+        }
+        std::memcpy(&values, words, sizeof(words));
+    }
+
+    /**
+     * @return The name of the segment of the simulator with the given pid.
+     */
+    static std::string name(unsigned long pid) {
+        return "/scheduler-live-" + std::to_string(pid);
+    }
+};
+
+/**
+ * @class LiveMetrics
+ * @brief Publishes the counters of the running simulation in a shared memory
+ * segment named after the pid of the simulator, for schedtop to read while
+ * the simulation goes on. The segment is removed when the simulator exits.
+ *
+ * The simulation loop only counts its iterations; the counters are gathered
+ * and written every PUBLISH_INTERVAL iterations (see due) and at the end of
+ * each run, so the loop never waits for a reader or for the clock.
+ */
+class LiveMetrics {
+public:
+    LiveMetrics() : segment(nullptr), scheduler_type(0), quantum(0),
+                    iterations(0), start(std::chrono::steady_clock::now()) {
+        path = LiveSegment::name(getpid());
+        int fd = shm_open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd >= 0) {
+            if (ftruncate(fd, sizeof(LiveSegment)) == 0) {
+                void* map = mmap(nullptr, sizeof(LiveSegment),
+                                 PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                if (map != MAP_FAILED)
+                    segment = static_cast<LiveSegment*>(map);
+            }
+            close(fd);
+        }
+        if (!segment) {
+            std::cout << "Erro ao criar a memória compartilhada " << path
+                      << std::endl;
+            shm_unlink(path.c_str());
+            return;
+        }
+        segment->magic = LiveSegment::MAGIC;
+    }
+
+    ~LiveMetrics() {
+        if (!segment)
+            return;
+        munmap(segment, sizeof(LiveSegment));
+        shm_unlink(path.c_str());
+    }
+
+    /**
+     * @brief Starts publishing the counters of a new run.
+     */
+    void begin_run(unsigned long scheduler_type_, unsigned long quantum_) {
+        scheduler_type = scheduler_type_;
+        quantum = quantum_;
+        iterations = 0;
+        start = std::chrono::steady_clock::now();
+    }
+
+    /**
+     * @brief Counts an iteration of the simulation loop.
+     * @return True if the counters are due to be published.
+     */
+    bool due() {
+        return ++iterations % PUBLISH_INTERVAL == 0;
+    }
+
+    /**
+     * @brief Publishes the counters, with the iterations and the wall time
+     * filled in.
+     */
+    void publish(LiveCounters& counters) {
+        if (!segment)
+            return;
+        counters.pid = getpid();
+        counters.scheduler_type = scheduler_type;
+        counters.quantum = quantum;
+        counters.iterations = iterations;
+        counters.wall_time = std::chrono::duration_cast<
+            std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+                                      start).count();
+        segment->write(counters);
+    }
+
+    static const uint64_t PUBLISH_INTERVAL = 4096;
+
+private:
+    std::string path;
+    LiveSegment* segment;
+    unsigned long scheduler_type;
+    unsigned long quantum;
+    uint64_t iterations;
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif // LIVE_METRICS_H
@@ -2,24 +2,40 @@
 
 int main(int argc , char** argv) {
 
-    if (argc < 2) {
-        std::cout << "Usage: ./scheduler <input_file> scheduler_type (optional) quantum (optional)" << std::endl;
+    // Arguments starting with "--" are options, the others are positional.
+    Options options;
+    std::vector<char*> args;
+    for (int i = 0; i < argc; i++) {
+        if (std::string(argv[i]).rfind("--", 0) == 0) {
+            if (!options.parse(argv[i])) {
+                std::cout << "Unknown option: " << argv[i] << std::endl;
+                Options::print_usage();
+                return 1;
+            }
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+
+    if (args.size() < 2) {
+        std::cout << "Usage: ./scheduler <input_file> scheduler_type (optional) quantum (optional) [options]" << std::endl;
+        Options::print_usage();
         return 1;
     }
 
     // As the second argument is optional, if it is not passed, the scheduler
     // type is set to 0, which means that all schedulers will be run.
     unsigned long scheduler_type = 0;
-    if (argc == 3)
-        scheduler_type = atoi(argv[2]);
+    if (args.size() >= 3)
+        scheduler_type = atoi(args[2]);
 
     // The third argument is also optional, if it is not passed, the quantum
     // is set to 2.
     unsigned long quantum = 2;
-    if (argc == 4)
-        quantum = atoi(argv[3]);
+    if (args.size() >= 4)
+        quantum = atoi(args[3]);
 
-    System system = System(argv[1]);
+    System system = System(args[1], options);
     system.start(scheduler_type, quantum);
     return 0;
 }
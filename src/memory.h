@@ -32,6 +32,13 @@ public:
             return Context();
     }
 
+    /**
+     * @brief Forgets the context of a process that is done.
+     */
+    void free_context(unsigned long pid) {
+        contextMap.erase(pid);
+    }
+
 private:
     std::unordered_map<int, Context> contextMap;
 };
@@ -0,0 +1,290 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include "cpu.h"
+#include "programs.h"
+#include "result_cache.h"
+#include "scheduler.h"
+#include "trace.h"
+
+enum AnalyticMode {
+    ANALYTIC_OFF,
+    ANALYTIC_ON,
+    ANALYTIC_CHECK
+};
+
+enum BatchMode {
+    BATCH_OFF,
+    BATCH_ON,
+    BATCH_CHECK
+};
+
+enum TimelineMode {
+    TIMELINE_FULL,
+    TIMELINE_ACTIVE,
+    TIMELINE_WINDOW,
+    TIMELINE_NONE
+};
+
+/**
+ * @class Options
+ * @brief Optional settings of a simulation run. They are given on the command
+ * line as --name=value, after the positional arguments.
+ */
+class Options {
+public:
+    Options() : timeline(TIMELINE_FULL),
+                first_pid(1),
+                last_pid(0),
+                header_interval(0),
+                run_records(0),
+                tmp_dir(std::getenv("TMPDIR") ? std::getenv("TMPDIR") : "/tmp"),
+                trace_format(TRACE_JSON),
+                analytic(ANALYTIC_OFF),
+                stride(false),
+                incremental(false),
+                aging(false),
+                aging_period(0),
+                pairing_heap(false),
+                batch(BATCH_OFF),
+                switch_cost(0),
+                cache_refill(0),
+                cache_half_life(SwitchCost::DEFAULT_HALF_LIFE),
+                live(false),
+                parallel(0),
+                retire(false),
+                diff_type(0),
+                diff_quantum(0),
+                adaptive_window(AdaptiveScheduler::DEFAULT_WINDOW),
+                cache_bytes(ResultCache::DEFAULT_MAX_BYTES) {}
+
+    ~Options() {}
+
+    /**
+     * @brief Parses one --name=value argument.
+     * @return False if the argument is not a known option.
+     */
+    bool parse(const std::string& argument) {
+        std::size_t equals = argument.find('=');
+        std::string name = argument.substr(0, equals);
+        std::string value = equals == std::string::npos ?
+                            "" : argument.substr(equals + 1);
+
+        if (name == "--timeline") {
+            if (value == "full")
+                timeline = TIMELINE_FULL;
+            else if (value == "active")
+                timeline = TIMELINE_ACTIVE;
+            else if (value == "none")
+                timeline = TIMELINE_NONE;
+            else
+                return false;
+        } else if (name == "--pids") {
+            std::size_t dash = value.find('-');
+            if (dash == std::string::npos)
+                return false;
+            first_pid = std::strtoul(value.substr(0, dash).c_str(), nullptr, 10);
+            last_pid = std::strtoul(value.substr(dash + 1).c_str(), nullptr, 10);
+            if (!first_pid || last_pid < first_pid)
+                return false;
+            timeline = TIMELINE_WINDOW;
+        } else if (name == "--header-every") {
+            header_interval = std::strtoul(value.c_str(), nullptr, 10);
+        } else if (name == "--external-sort") {
+            run_records = value.empty() ?
+                          DEFAULT_RUN_RECORDS :
+                          std::strtoul(value.c_str(), nullptr, 10);
+            if (!run_records)
+                return false;
+        } else if (name == "--tmpdir") {
+            tmp_dir = value;
+        } else if (name == "--trace") {
+            trace_file = value;
+            if (value.size() > 8 &&
+                value.compare(value.size() - 8, 8, ".pftrace") == 0)
+                trace_format = TRACE_PERFETTO;
+        } else if (name == "--trace-format") {
+            if (value == "json")
+                trace_format = TRACE_JSON;
+            else if (value == "perfetto")
+                trace_format = TRACE_PERFETTO;
+            else
+                return false;
+        } else if (name == "--program") {
+            if (!ProgramLibrary::exists(value))
+                return false;
+            program = value;
+        } else if (name == "--adaptive-window") {
+            adaptive_window = std::strtoul(value.c_str(), nullptr, 10);
+            if (!adaptive_window)
+                return false;
+        } else if (name == "--adaptive-log") {
+            adaptive_log = value;
+        } else if (name == "--cache") {
+            cache_dir = value.empty() ? ResultCache::default_dir() : value;
+        } else if (name == "--cache-size") {
+            cache_bytes = std::strtoull(value.c_str(), nullptr, 10) << 20;
+            if (!cache_bytes)
+                return false;
+        } else if (name == "--stride") {
+            stride = true;
+        } else if (name == "--aging") {
+            aging = true;
+            aging_period = std::strtoul(value.c_str(), nullptr, 10);
+        } else if (name == "--pairing-heap") {
+            pairing_heap = true;
+        } else if (name == "--batch") {
+            if (value.empty())
+                batch = BATCH_ON;
+            else if (value == "check")
+                batch = BATCH_CHECK;
+            else
+                return false;
+        } else if (name == "--switch-cost") {
+            char* end;
+            switch_cost = std::strtod(value.c_str(), &end);
+            if (*end == ',')
+                cache_refill = std::strtod(end + 1, &end);
+            if (*end == ',')
+                cache_half_life = std::strtod(end + 1, &end);
+            if (*end || end == value.c_str() || switch_cost < 0 ||
+                cache_refill < 0 || !(cache_half_life > 0))
+                return false;
+        } else if (name == "--live") {
+            live = true;
+        } else if (name == "--retire") {
+            retire = true;
+        } else if (name == "--parallel") {
+            parallel = value.empty() ?
+                       std::max(1u, std::thread::hardware_concurrency()) :
+                       std::strtoul(value.c_str(), nullptr, 10);
+            if (!parallel)
+                return false;
+        } else if (name == "--diff") {
+            std::size_t comma = value.find(',');
+            diff_type = std::strtoul(value.substr(0, comma).c_str(),
+                                     nullptr, 10);
+            diff_quantum = comma == std::string::npos ? 0 :
+                           std::strtoul(value.substr(comma + 1).c_str(),
+                                        nullptr, 10);
+            if (!diff_type || (comma != std::string::npos && !diff_quantum))
+                return false;
+        } else if (name == "--incremental") {
+            incremental = true;
+        } else if (name == "--analytic") {
+            if (value.empty())
+                analytic = ANALYTIC_ON;
+            else if (value == "check")
+                analytic = ANALYTIC_CHECK;
+            else
+                return false;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Prints the accepted options.
+     */
+    static void print_usage() {
+        std::cout
+        << "Options:" << std::endl
+        << "  --timeline=full|active|none  Columns of the timeline: every "
+           "process, only created and unfinished ones, or no timeline"
+        << std::endl
+        << "  --pids=<first>-<last>        Only prints the columns of the "
+           "given pids" << std::endl
+        << "  --header-every=<rows>        Reprints the timeline header every "
+           "<rows> rows" << std::endl
+        << "  --external-sort[=<records>]  Sorts the input on disk in runs of "
+           "<records> processes and streams it" << std::endl
+        << "  --tmpdir=<dir>               Directory of the sorted runs"
+        << std::endl
+        << "  --trace=<file>               Writes the state transitions as a "
+           "trace (Perfetto if <file> ends in .pftrace)" << std::endl
+        << "  --trace-format=json|perfetto Format of the trace" << std::endl
+        << "  --analytic[=check]           Computes FCFS, SJF and PNP without "
+           "simulating each second (no timeline); check also simulates and "
+           "compares" << std::endl
+        << "  --stride                     Runs each process for a whole slice "
+           "at once (until its quantum, end or the next arrival)" << std::endl
+        << "  --program=<name>             Every process runs a program: "
+           "bursts, interactive, fork or nice" << std::endl
+        << "  --adaptive-window=<seconds>  Window after which the adaptive "
+           "scheduler (type 6) reviews its policy" << std::endl
+        << "  --adaptive-log=<file>        Writes the metrics and decision of "
+           "every window of the adaptive scheduler as CSV" << std::endl
+        << "  --cache[=<dir>]              Reuses the output of identical "
+           "runs, cached in <dir> (default ~/.cache/scheduler)" << std::endl
+        << "  --cache-size=<MB>            Size of the cache, least recently "
+           "used outputs are evicted (default 256)" << std::endl
+        << "  --incremental                Saves a snapshot next to the input "
+           "and, after lines are appended to it, only simulates from there "
+           "(no timeline)" << std::endl
+        << "  --aging=<seconds>            Priority schedulers raise the "
+           "priority of a waiting process every <seconds> (0 never) and "
+           "report the waits of each priority" << std::endl
+        << "  --pairing-heap               Keeps the ready processes of SJF, "
+           "PNP, PP and adaptive in a pairing heap, with ties in arrival order"
+        << std::endl
+        << "  --batch[=check]              The input file lists one workload "
+           "per line, simulated together with FCFS or RR into a CSV of their "
+           "statistics; check also simulates each one and compares"
+        << std::endl
+        << "  --switch-cost=<ms>[,<refill ms>[,<half-life>]]" << std::endl
+        << "                               Each context switch costs <ms>, "
+           "plus up to <refill ms> to refill a cache that halves every "
+           "<half-life> seconds (default 10) and at each other process run"
+        << std::endl
+        << "  --diff=<type>[,<quantum>]    Also runs the scheduler <type> and "
+           "compares the two runs: first divergence and deltas of each process"
+        << std::endl
+        << "  --live                       Publishes the progress of the run "
+           "in shared memory, for schedtop" << std::endl
+        << "  --parallel[=<threads>]       Simulates the busy periods of the "
+           "CPU on several threads (types 1 to 5, no I/O, no timeline)"
+        << std::endl
+        << "  --retire                     Keeps only the unfinished processes "
+           "in memory and the statistics of the others in a temporary file "
+           "(no timeline)" << std::endl;
+    }
+
+    unsigned long timeline;         // TimelineMode
+    unsigned long first_pid;        // First column of TIMELINE_WINDOW
+    unsigned long last_pid;         // Last column of TIMELINE_WINDOW
+    unsigned long header_interval;  // 0 prints the header only when needed
+    unsigned long run_records;      // 0 sorts the input in memory
+    std::string tmp_dir;
+    std::string trace_file;         // Empty disables the trace
+    unsigned long trace_format;     // TraceFormat
+    unsigned long analytic;         // AnalyticMode
+    bool stride;
+    bool incremental;               // Resumes from a snapshot of the input
+    bool aging;                     // Reports the waits of each priority
+    unsigned long aging_period;     // 0 keeps the static priorities
+    bool pairing_heap;              // Keyed ready queues are pairing heaps
+    unsigned long batch;            // BatchMode
+    double switch_cost;             // Milliseconds, 0 and no refill disable
+    double cache_refill;            // Milliseconds to refill a cold cache
+    double cache_half_life;         // Seconds
+    bool live;                      // Publishes counters for schedtop
+    unsigned long parallel;         // Threads, 0 simulates sequentially
+    bool retire;                    // Frees the processes that are done
+    unsigned long diff_type;        // 0 disables the diff
+    unsigned long diff_quantum;     // 0 is the quantum of the first run
+    std::string program;            // Empty if processes run no program
+    unsigned long adaptive_window;  // Seconds between reviews of the policy
+    std::string adaptive_log;       // Empty disables the decision log
+    std::string cache_dir;          // Empty disables the result cache
+    uint64_t cache_bytes;
+
+    static const unsigned long DEFAULT_RUN_RECORDS = 1 << 20;
+};
+
+#endif // OPTIONS_H
@@ -0,0 +1,329 @@
+#ifndef OUTPUT_PIPELINE_H
+#define OUTPUT_PIPELINE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include "process.h"
+
+/**
+ * @class SPSCRing
+ * @brief Lock-free single-producer single-consumer byte ring buffer.
+ *
+ * The producer appends whole records and publishes them by advancing the
+ * head; the consumer only ever sees complete records. Head and tail grow
+ * monotonically and are reduced modulo the capacity, which must be a power
+ * of two.
+ */
+class SPSCRing {
+public:
+    SPSCRing(std::size_t capacity_) : capacity(capacity_),
+                                      mask(capacity_ - 1),
+                                      buffer(new char[capacity_]),
+                                      head(0),
+                                      tail(0) {}
+
+    ~SPSCRing() {
+        delete[] buffer;
+    }
+
+    /**
+     * @brief Appends a record, waiting for the consumer while the ring is
+     * full. Must only be called from the producer thread.
+     */
+    void push(const char* data, std::size_t size) {
+        std::size_t h = head.load(std::memory_order_relaxed);
+        while (capacity - (h - tail.load(std::memory_order_acquire)) < size)
+            std::this_thread::yield();
+        copy_in(h, data, size);
+        head.store(h + size, std::memory_order_release);
+    }
+
+    /**
+     * @brief Returns the number of bytes published and not yet consumed.
+     */
+    std::size_t available() const {
+        return head.load(std::memory_order_acquire) -
+               tail.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Copies size bytes starting offset bytes after the tail.
+     */
+    void peek(std::size_t offset, char* out, std::size_t size) const {
+        std::size_t begin = (tail.load(std::memory_order_relaxed) + offset) & mask;
+        std::size_t first = std::min(size, capacity - begin);
+        std::memcpy(out, buffer + begin, first);
+        std::memcpy(out + first, buffer, size - first);
+    }
+
+    /**
+     * @brief Releases size bytes back to the producer.
+     */
+    void consume(std::size_t size) {
+        tail.store(tail.load(std::memory_order_relaxed) + size,
+                   std::memory_order_release);
+    }
+
+private:
+    std::size_t capacity;
+    std::size_t mask;
+    char* buffer;
+    alignas(64) std::atomic<std::size_t> head;
+    alignas(64) std::atomic<std::size_t> tail;
+
+    void copy_in(std::size_t position, const char* data, std::size_t size) {
+        std::size_t begin = position & mask;
+        std::size_t first = std::min(size, capacity - begin);
+        std::memcpy(buffer + begin, data, first);
+        std::memcpy(buffer, data + first, size - first);
+    }
+};
+
+/**
+ * @class TimelineWriter
+ * @brief Formats and writes the scheduling timeline on a dedicated thread.
+ *
+ * The simulation thread only pushes compact records (a time stamp, one state
+ * byte per column, or the pids of a header) into an SPSCRing. The writer
+ * thread formats them in batches exactly as the iostream version did and
+ * writes them to the file descriptor with write(2). While the ring is empty,
+ * the writer thread blocks on an atomic wait, and each push wakes it.
+ */
+class TimelineWriter {
+public:
+    TimelineWriter(int fd_ = STDOUT_FILENO) : fd(fd_),
+                                              ring(RING_CAPACITY),
+                                              closing(false),
+                                              sleeping(false) {
+        out.reserve(BATCH_SIZE * 2);
+        writer = std::thread(&TimelineWriter::write_loop, this);
+    }
+
+    ~TimelineWriter() {
+        close();
+    }
+
+    /**
+     * @brief Starts a header line: the "tempo" column label.
+     */
+    void begin_header() {
+        push_kind(HEADER);
+    }
+
+    /**
+     * @brief Appends one "P<pid>" column label per pid to the header.
+     */
+    void header_pids(const unsigned long* pids, std::size_t count) {
+        while (count) {
+            uint32_t n = std::min<std::size_t>(count, CHUNK / sizeof(uint64_t));
+            char record[1 + sizeof(uint32_t) + CHUNK];
+            record[0] = PIDS;
+            std::memcpy(record + 1, &n, sizeof(n));
+            for (uint32_t i = 0; i < n; i++) {
+                uint64_t pid = pids[i];
+                std::memcpy(record + 1 + sizeof(n) + i * sizeof(pid),
+                            &pid, sizeof(pid));
+            }
+            push(record, 1 + sizeof(n) + n * sizeof(uint64_t));
+            pids += n;
+            count -= n;
+        }
+    }
+
+    /**
+     * @brief Starts a timeline row: the "<time>-<time+1>" column.
+     */
+    void begin_row(unsigned long current_time) {
+        char record[1 + sizeof(uint64_t)];
+        uint64_t time = current_time;
+        record[0] = ROW;
+        std::memcpy(record + 1, &time, sizeof(time));
+        push(record, sizeof(record));
+    }
+
+    /**
+     * @brief Appends one column per state (see States) to the current row.
+     */
+    void row_states(const unsigned char* states, std::size_t count) {
+        while (count) {
+            uint32_t n = std::min<std::size_t>(count, CHUNK);
+            char record[1 + sizeof(uint32_t) + CHUNK];
+            record[0] = STATES;
+            std::memcpy(record + 1, &n, sizeof(n));
+            std::memcpy(record + 1 + sizeof(n), states, n);
+            push(record, 1 + sizeof(n) + n);
+            states += n;
+            count -= n;
+        }
+    }
+
+    /**
+     * @brief Ends the current header or row.
+     */
+    void end_line() {
+        push_kind(NEWLINE);
+    }
+
+    /**
+     * @brief Waits until every pushed record has been written and stops the
+     * writer thread.
+     */
+    void close() {
+        if (writer.joinable()) {
+            closing.store(true, std::memory_order_release);
+            wake();
+            writer.join();
+        }
+    }
+
+private:
+    enum RecordKind : char {
+        HEADER = 1,
+        PIDS,
+        ROW,
+        STATES,
+        NEWLINE
+    };
+
+    static constexpr std::size_t RING_CAPACITY = 1 << 22;
+    static constexpr std::size_t BATCH_SIZE = 1 << 16;
+    static constexpr std::size_t CHUNK = 1 << 12;
+
+    int fd;
+    SPSCRing ring;
+    std::atomic<bool> closing;
+    std::atomic<bool> sleeping;     // The writer waits for records
+    std::string out;
+    std::thread writer;
+
+    void push_kind(char kind) {
+        push(&kind, 1);
+    }
+
+    void push(const char* record, std::size_t size) {
+        ring.push(record, size);
+        wake();
+    }
+
+    // Wakes the writer thread if it waits for records. The fences order the
+    // head of the ring and sleeping on both sides, so either the writer sees
+    // the record or the producer sees it sleeping.
+    void wake() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping.load(std::memory_order_relaxed)) {
+            sleeping.store(false, std::memory_order_relaxed);
+            sleeping.notify_one();
+        }
+    }
+
+    // Consumes and formats records until the producer closes the writer and
+    // the ring is empty.
+    void write_loop() {
+        while (true) {
+            std::size_t available = ring.available();
+            if (available) {
+                ring.consume(format(available));
+                if (out.size() >= BATCH_SIZE)
+                    flush();
+                continue;
+            }
+            flush();
+            if (closing.load(std::memory_order_acquire) && !ring.available())
+                break;
+            sleeping.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!ring.available() && !closing.load(std::memory_order_relaxed))
+                sleeping.wait(true, std::memory_order_acquire);
+            sleeping.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    // Formats the records in the first available bytes of the ring and
+    // returns the number of bytes consumed.
+    std::size_t format(std::size_t available) {
+        std::size_t offset = 0;
+        char record[1 + sizeof(uint32_t) + CHUNK];
+        while (offset < available && out.size() < BATCH_SIZE) {
+            char kind;
+            ring.peek(offset, &kind, 1);
+            offset += 1;
+            switch (kind)
+            {
+            case HEADER:
+                out.append("   tempo   ");
+                break;
+            case PIDS: {
+                uint32_t n;
+                ring.peek(offset, reinterpret_cast<char*>(&n), sizeof(n));
+                ring.peek(offset + sizeof(n), record, n * sizeof(uint64_t));
+                offset += sizeof(n) + n * sizeof(uint64_t);
+                for (uint32_t i = 0; i < n; i++) {
+                    uint64_t pid;
+                    std::memcpy(&pid, record + i * sizeof(pid), sizeof(pid));
+                    append_aligned("P" + std::to_string(pid), 4, true);
+                }
+                break;
+            }
+            case ROW: {
+                uint64_t time;
+                ring.peek(offset, reinterpret_cast<char*>(&time), sizeof(time));
+                offset += sizeof(time);
+                append_aligned(std::to_string(time), 5, true);
+                out.push_back('-');
+                append_aligned(std::to_string(time + 1), 5, false);
+                break;
+            }
+            case STATES: {
+                uint32_t n;
+                ring.peek(offset, reinterpret_cast<char*>(&n), sizeof(n));
+                ring.peek(offset + sizeof(n), record, n);
+                offset += sizeof(n) + n;
+                for (uint32_t i = 0; i < n; i++) {
+                    out.append("  ");
+                    out.append(Process::state_mnemonic(
+                        static_cast<unsigned char>(record[i])));
+                }
+                break;
+            }
+            case NEWLINE:
+                out.push_back('\n');
+                break;
+            default:
+                break;
+            }
+        }
+        return offset;
+    }
+
+    // Same padding as std::setw with std::right or std::left.
+    void append_aligned(const std::string& text, std::size_t width, bool right) {
+        std::size_t padding = text.size() < width ? width - text.size() : 0;
+        if (!right)
+            out.append(text);
+        out.append(padding, ' ');
+        if (right)
+            out.append(text);
+    }
+
+    void flush() {
+        std::size_t written = 0;
+        while (written < out.size()) {
+            ssize_t n = ::write(fd, out.data() + written, out.size() - written);
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                break;
+            }
+            written += n;
+        }
+        out.clear();
+    }
+};
+
+#endif // OUTPUT_PIPELINE_H
@@ -0,0 +1,283 @@
+#ifndef PAIRING_QUEUE_H
+#define PAIRING_QUEUE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "process.h"
+#include "process_queue.h"
+
+/**
+ * @brief A node of a pairing heap: its process, the order in which it was
+ * pushed, its first child and its next sibling.
+ */
+struct PairingNode {
+    Process* process;
+    uint64_t sequence;
+    PairingNode* child;
+    PairingNode* sibling;   // Next free node while in the free list
+};
+
+/**
+ * @class PairingNodePool
+ * @brief Allocates the nodes of pairing heaps in blocks and recycles them
+ * through a free list, so pushing a process costs no call to the allocator.
+ * Heaps that share a pool can be melded in O(1). The pool also numbers the
+ * pushes, so the order of the processes with equal keys holds across heaps.
+ */
+class PairingNodePool {
+public:
+    PairingNodePool() : free_nodes(nullptr), sequence(0) {}
+
+    ~PairingNodePool() {
+        for (PairingNode* block : blocks)
+            delete[] block;
+    }
+
+    PairingNode* allocate(Process* process) {
+        if (!free_nodes)
+            grow();
+        PairingNode* node = free_nodes;
+        free_nodes = node->sibling;
+        *node = {process, sequence++, nullptr, nullptr};
+        return node;
+    }
+
+    void release(PairingNode* node) {
+        node->sibling = free_nodes;
+        free_nodes = node;
+    }
+
+private:
+    static const std::size_t BLOCK_NODES = 1024;
+
+    std::vector<PairingNode*> blocks;
+    PairingNode* free_nodes;
+    uint64_t sequence;
+
+    void grow() {
+        PairingNode* block = new PairingNode[BLOCK_NODES];
+        blocks.push_back(block);
+        for (std::size_t i = 0; i < BLOCK_NODES; i++)
+            release(&block[i]);
+    }
+};
+
+/**
+ * @class PairingProcessQueue
+ * @brief Pairing heap of processes ordered by Comparator, like
+ * PriorityProcessQueue, with processes of equal keys in the order they were
+ * pushed.
+ *
+ * Pushing a process and melding two heaps cost O(1), and popping costs
+ * O(log n) amortized. push_range links the new processes into a heap of their
+ * own in O(k) and melds it, so a burst of k arrivals costs O(k) instead of
+ * O(k log n), and, as ties keep the order of the pushes, gives the same queue
+ * as pushing them one by one.
+ */
+template <typename Comparator>
+class PairingProcessQueue : public ProcessQueueWrapper {
+public:
+    PairingProcessQueue(const Comparator& c) :
+        comparator(c), pool(new PairingNodePool()), owns_pool(true),
+        root(nullptr), count(0) {}
+
+    /**
+     * @brief Creates a heap whose nodes come from pool_, which is not owned
+     * by the heap, so it can be melded in O(1) with the other heaps of the
+     * pool.
+     */
+    PairingProcessQueue(const Comparator& c, PairingNodePool* pool_) :
+        comparator(c), pool(pool_), owns_pool(false),
+        root(nullptr), count(0) {}
+
+    ~PairingProcessQueue() {
+        clear();
+        if (owns_pool)
+            delete pool;
+    }
+
+    void push(Process* process) override {
+        root = link(root, pool->allocate(process));
+        count++;
+    }
+
+    Process* front() override {
+        if (root) {
+            return root->process;
+        }
+        return nullptr; // Return nullptr if the queue is empty
+    }
+
+    void pop() override {
+        if (!root)
+            return;
+        PairingNode* popped = root;
+        root = merge_pairs(root->child);
+        pool->release(popped);
+        count--;
+    }
+
+    bool empty() override {
+        return !root;
+    }
+
+    std::size_t size() override {
+        return count;
+    }
+
+    void take_all(std::vector<Process*>& processes) override {
+        visit([this, &processes](PairingNode* node) {
+            processes.push_back(node->process);
+            pool->release(node);
+        });
+        root = nullptr;
+        count = 0;
+    }
+
+    /**
+     * @brief Links the processes into a heap of their own, pairing them
+     * level by level in O(k), and melds it into the queue.
+     */
+    void push_range(const std::vector<Process*>& processes) override {
+        if (processes.empty())
+            return;
+        std::vector<PairingNode*> level;
+        level.reserve(processes.size());
+        for (Process* process : processes)
+            level.push_back(pool->allocate(process));
+        while (level.size() > 1) {
+            std::size_t linked = 0;
+            for (std::size_t i = 0; i + 1 < level.size(); i += 2)
+                level[linked++] = link(level[i], level[i + 1]);
+            if (level.size() % 2)
+                level[linked++] = level.back();
+            level.resize(linked);
+        }
+        root = link(root, level.front());
+        count += processes.size();
+    }
+
+    void push_in_order(const std::vector<Process*>& processes) override {
+        push_range(processes);
+    }
+
+    /**
+     * @brief Moves every process of other into the queue and leaves other
+     * empty. O(1) if both heaps share their pool, O(k) otherwise.
+     */
+    void meld(PairingProcessQueue& other) {
+        if (other.pool != pool) {
+            std::vector<Process*> processes;
+            other.copy_to(processes);
+            other.clear();
+            push_range(processes);
+            return;
+        }
+        root = link(root, other.root);
+        count += other.count;
+        other.root = nullptr;
+        other.count = 0;
+    }
+
+    /**
+     * @brief Appends the processes in the order they were pushed, which
+     * assign needs to restore the order of equal keys.
+     */
+    void copy_to(std::vector<Process*>& processes) override {
+        std::vector<PairingNode*> nodes;
+        nodes.reserve(count);
+        visit([&nodes](PairingNode* node) {
+            nodes.push_back(node);
+        });
+        std::sort(nodes.begin(), nodes.end(),
+            [](const PairingNode* lhs, const PairingNode* rhs) {
+                return lhs->sequence < rhs->sequence;
+            });
+        for (PairingNode* node : nodes)
+            processes.push_back(node->process);
+    }
+
+    void assign(const std::vector<Process*>& processes) override {
+        clear();
+        push_range(processes);
+    }
+
+private:
+    Comparator comparator;
+    PairingNodePool* pool;
+    bool owns_pool;
+    PairingNode* root;
+    std::size_t count;
+    std::vector<PairingNode*> pairs;    // Scratch space of merge_pairs
+    std::vector<PairingNode*> pending;  // Scratch space of visit
+
+    // True if lhs comes out of the heap before rhs.
+    bool before(const PairingNode* lhs, const PairingNode* rhs) {
+        if (comparator(rhs->process, lhs->process))
+            return true;
+        if (comparator(lhs->process, rhs->process))
+            return false;
+        return lhs->sequence < rhs->sequence;
+    }
+
+    // Makes the root that comes out later the first child of the other.
+    PairingNode* link(PairingNode* lhs, PairingNode* rhs) {
+        if (!lhs)
+            return rhs;
+        if (!rhs)
+            return lhs;
+        if (before(rhs, lhs))
+            std::swap(lhs, rhs);
+        rhs->sibling = lhs->child;
+        lhs->child = rhs;
+        return lhs;
+    }
+
+    // Links the siblings in pairs from the first, then the pairs from the
+    // last to the first: the two passes that bound pop to O(log n)
+    // amortized.
+    PairingNode* merge_pairs(PairingNode* first) {
+        pairs.clear();
+        while (first) {
+            PairingNode* second = first->sibling;
+            PairingNode* next = second ? second->sibling : nullptr;
+            first->sibling = nullptr;
+            if (second)
+                second->sibling = nullptr;
+            pairs.push_back(link(first, second));
+            first = next;
+        }
+        PairingNode* merged = nullptr;
+        for (auto pair = pairs.rbegin(); pair != pairs.rend(); ++pair)
+            merged = link(*pair, merged);
+        return merged;
+    }
+
+    // Calls visitor on every node, which may release it.
+    template <typename Visitor>
+    void visit(Visitor visitor) {
+        pending.clear();
+        if (root)
+            pending.push_back(root);
+        while (!pending.empty()) {
+            PairingNode* node = pending.back();
+            pending.pop_back();
+            if (node->sibling)
+                pending.push_back(node->sibling);
+            if (node->child)
+                pending.push_back(node->child);
+            visitor(node);
+        }
+    }
+
+    void clear() {
+        visit([this](PairingNode* node) {
+            pool->release(node);
+        });
+        root = nullptr;
+        count = 0;
+    }
+};
+
+#endif // PAIRING_QUEUE_H
@@ -2,14 +2,382 @@
 #define PROCESS_H
 
 #include <climits>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 enum States {
     NEW,
     READY,
     RUNNING,
-    DONE
+    DONE,
+    BLOCKED,
+    SWITCHING   // Only in the timeline: RUNNING, while the CPU switches to it
 };
 
+/**
+ * @brief Every field of a process, in either layout. Used to save the state of
+ * a simulation and to restore it (see Process::get_snapshot).
+ */
+struct ProcessSnapshot {
+    unsigned long pid;
+    unsigned long duration;
+    unsigned long priority;
+    unsigned long creation_time;
+    unsigned long total_execution_time;
+    unsigned long state;
+    unsigned long start;            // ULONG_MAX if it never ran
+    unsigned long end;
+    unsigned long waiting_time;
+    unsigned long last_interrupt;
+    unsigned long context_changes;
+    unsigned long io_time;
+    std::vector<unsigned long> bursts;
+    unsigned long next_burst;
+};
+
+#ifdef COMPACT_PROCESS
+
+/**
+ * @class Process
+ * @brief Compact layout of a process, selected with -DCOMPACT_PROCESS, with
+ * the same interface as the default one below.
+ *
+ * Only the fields used by the schedulers on every second (pid, duration,
+ * execution time, priority and state) are kept in the object, in 16 bytes:
+ * times are 32 bits and the priority (24 bits) shares a word with the state.
+ * The statistics are kept apart in a table indexed by pid, as are the bursts
+ * of the processes that do I/O, and the objects are allocated from a pool.
+ * The workload must fit these widths (see fits).
+ */
+class Process {
+public:
+    Process() : pid(0),
+                duration(0),
+                total_execution_time(0),
+                priority_state(0) {
+        reset_stats(0);
+    }
+
+    Process(unsigned long pid_,
+            unsigned long duration_,
+            unsigned long priority_,
+            unsigned long creation_time_) :
+        pid(static_cast<uint32_t>(pid_)),
+        duration(static_cast<uint32_t>(duration_)),
+        total_execution_time(0),
+        priority_state(static_cast<uint32_t>(priority_ << STATE_BITS)) {
+        reset_stats(creation_time_);
+    }
+
+    explicit Process(const ProcessSnapshot& snapshot) :
+        pid(static_cast<uint32_t>(snapshot.pid)),
+        duration(static_cast<uint32_t>(snapshot.duration)),
+        total_execution_time(static_cast<uint32_t>(snapshot.total_execution_time)),
+        priority_state(static_cast<uint32_t>(snapshot.priority << STATE_BITS |
+                                             snapshot.state)) {
+        reset_stats(snapshot.creation_time);
+        stats() = {static_cast<uint32_t>(snapshot.creation_time),
+                   snapshot.start == ULONG_MAX ?
+                   UINT32_MAX : static_cast<uint32_t>(snapshot.start),
+                   static_cast<uint32_t>(snapshot.end),
+                   static_cast<uint32_t>(snapshot.waiting_time),
+                   static_cast<uint32_t>(snapshot.last_interrupt),
+                   static_cast<uint32_t>(snapshot.context_changes),
+                   static_cast<uint32_t>(snapshot.io_time)};
+        if (!snapshot.bursts.empty()) {
+            Bursts& entry = burst_table()[pid];
+            entry.durations.assign(snapshot.bursts.begin(), snapshot.bursts.end());
+            entry.next = snapshot.next_burst;
+        }
+    }
+
+    ~Process() {}
+
+    static void* operator new(std::size_t size) {
+        return pool().allocate(size);
+    }
+
+    static void operator delete(void* process) {
+        pool().release(process);
+    }
+
+    /**
+     * @return True if a process and the times of the simulation, up to
+     * max_time, fit in the compact layout.
+     */
+    static bool fits(unsigned long max_time,
+                     unsigned long priority_,
+                     unsigned long pid_) {
+        return max_time < UINT32_MAX &&
+               priority_ < (1ul << (32 - STATE_BITS)) &&
+               pid_ < UINT32_MAX;
+    }
+
+    /**
+     * @brief Reserves the statistics of the pids up to count, so the table is
+     * not copied while it grows.
+     */
+    static void reserve(unsigned long count) {
+        stats_table().reserve(count + 1);
+    }
+
+    void run() {
+        total_execution_time++;
+    }
+
+    void run(unsigned long seconds) {
+        total_execution_time += static_cast<uint32_t>(seconds);
+    }
+
+    bool is_done() {
+        return total_execution_time >= duration;
+    }
+
+    void set_bursts(const std::vector<unsigned long>& bursts_) {
+        Bursts& entry = burst_table()[pid];
+        entry.durations.assign(bursts_.begin(), bursts_.end());
+        entry.next = 0;
+    }
+
+    bool has_io() const {
+        auto entry = burst_table().find(pid);
+        return entry != burst_table().end() &&
+               entry->second.next + 1 < entry->second.durations.size();
+    }
+
+    unsigned long get_io_duration() const {
+        const Bursts& entry = burst_table()[pid];
+        return entry.durations[entry.next];
+    }
+
+    void next_cpu_burst() {
+        Bursts& entry = burst_table()[pid];
+        duration = entry.durations[entry.next + 1];
+        total_execution_time = 0;
+        entry.next += 2;
+    }
+
+    void start_burst(unsigned long duration_) {
+        duration = static_cast<uint32_t>(duration_);
+        total_execution_time = 0;
+    }
+
+    void extend_burst(unsigned long seconds) {
+        duration += static_cast<uint32_t>(seconds);
+    }
+
+    void set_priority(unsigned long priority_) {
+        priority_state = static_cast<uint32_t>(priority_ << STATE_BITS) |
+                         (priority_state & STATE_MASK);
+    }
+
+    void set_state(unsigned long state_, unsigned long current_time) {
+        Stats& cold = stats();
+        uint32_t time = static_cast<uint32_t>(current_time);
+        switch (state_)
+        {
+        case READY:
+            if (get_state_id() == BLOCKED)
+                cold.io_time += time - cold.last_interrupt;
+            set_state_id(READY);
+            cold.last_interrupt = time;
+            break;
+        case RUNNING:
+            if (get_state_id() == READY) {
+                cold.waiting_time += time - cold.last_interrupt;
+                cold.context_changes++;
+            }
+            set_state_id(RUNNING);
+            cold.start = time > cold.start ? cold.start : time;
+            break;
+        case DONE:
+            set_state_id(DONE);
+            cold.end = time;
+            break;
+        case BLOCKED:
+            set_state_id(BLOCKED);
+            cold.last_interrupt = time;
+            break;
+        default:
+            break;
+        }
+    }
+
+    std::string get_state() {
+        return state_mnemonic(get_state_id());
+    }
+
+    static const char* state_mnemonic(unsigned long state_) {
+        switch (state_)
+        {
+        case READY:
+            return "--";
+        case RUNNING:
+            return "##";
+        case SWITCHING:
+            return "~~";
+        case BLOCKED:
+            return "..";
+        default:
+            return "  ";
+        }
+    }
+
+    unsigned long get_state_id() const {
+        return priority_state & STATE_MASK;}
+
+    unsigned long get_pid() const {
+        return pid;}
+
+    unsigned long get_duration() const {
+        return duration;}
+
+    unsigned long get_priority() const {
+        return priority_state >> STATE_BITS;}
+
+    unsigned long get_creation_time() const {
+        return stats().creation_time;}
+
+    unsigned long get_total_execution_time() const {
+        return total_execution_time;}
+
+    unsigned long get_start() const {
+        return stats().start == UINT32_MAX ? ULONG_MAX : stats().start;}
+
+    unsigned long get_end() const {
+        return stats().end;}
+
+    unsigned long get_waiting_time() const {
+        return stats().waiting_time;}
+
+    unsigned long get_turnaround_time() const {
+        return stats().end - stats().creation_time;}
+
+    unsigned long get_context_changes() const {
+        return stats().context_changes;}
+
+    unsigned long get_io_time() const {
+        return stats().io_time;}
+
+    unsigned long get_last_interrupt() const {
+        return stats().last_interrupt;}
+
+    ProcessSnapshot get_snapshot() const {
+        const Stats& cold = stats();
+        ProcessSnapshot snapshot = {pid, duration, get_priority(),
+                                    cold.creation_time, total_execution_time,
+                                    get_state_id(), get_start(), cold.end,
+                                    cold.waiting_time, cold.last_interrupt,
+                                    cold.context_changes, cold.io_time, {}, 0};
+        auto entry = burst_table().find(pid);
+        if (entry != burst_table().end()) {
+            snapshot.bursts.assign(entry->second.durations.begin(),
+                                   entry->second.durations.end());
+            snapshot.next_burst = entry->second.next;
+        }
+        return snapshot;
+    }
+
+protected:
+    static constexpr unsigned STATE_BITS = 8;
+    static constexpr uint32_t STATE_MASK = (1u << STATE_BITS) - 1;
+
+    // Statistics of a process, only touched on its state changes.
+    struct Stats {
+        uint32_t creation_time;
+        uint32_t start;
+        uint32_t end;
+        uint32_t waiting_time;
+        uint32_t last_interrupt;
+        uint32_t context_changes;
+        uint32_t io_time;
+    };
+
+    // The bursts after the first one, only for the processes that do I/O.
+    struct Bursts {
+        std::vector<uint32_t> durations;
+        std::size_t next;
+    };
+
+    // Fixed size blocks of process objects, reused through a free list.
+    class Pool {
+    public:
+        Pool() : free_slots(nullptr) {}
+
+        void* allocate(std::size_t size) {
+            if (size != sizeof(Process))
+                return ::operator new(size);
+            if (!free_slots) {
+                Slot* block = new Slot[BLOCK_SLOTS];
+                for (std::size_t i = 0; i < BLOCK_SLOTS; i++)
+                    release(&block[i]);
+            }
+            Slot* slot = free_slots;
+            free_slots = slot->next;
+            return slot;
+        }
+
+        void release(void* process) {
+            Slot* slot = static_cast<Slot*>(process);
+            slot->next = free_slots;
+            free_slots = slot;
+        }
+
+    private:
+        static constexpr std::size_t BLOCK_SLOTS = 4096;
+
+        union Slot {
+            Slot* next;
+            unsigned char bytes[16];
+        };
+        Slot* free_slots;
+    };
+
+    uint32_t pid;
+    uint32_t duration;
+    uint32_t total_execution_time;
+    uint32_t priority_state;
+
+    static std::vector<Stats>& stats_table() {
+        static std::vector<Stats> table;
+        return table;
+    }
+
+    static std::unordered_map<uint32_t, Bursts>& burst_table() {
+        static std::unordered_map<uint32_t, Bursts> table;
+        return table;
+    }
+
+    static Pool& pool() {
+        static Pool processes;
+        return processes;
+    }
+
+    Stats& stats() const {
+        return stats_table()[pid];
+    }
+
+    // Pids are reused by each simulation, so the row of the pid is cleared.
+    void reset_stats(unsigned long creation_time_) {
+        std::vector<Stats>& table = stats_table();
+        if (pid >= table.size())
+            table.resize(pid + 1);
+        table[pid] = {static_cast<uint32_t>(creation_time_),
+                      UINT32_MAX, 0, 0, 0, 0, 0};
+        burst_table().erase(pid);
+    }
+
+    void set_state_id(uint32_t state_) {
+        priority_state = (priority_state & ~STATE_MASK) | state_;
+    }
+};
+
+static_assert(sizeof(Process) <= 16, "the compact process must fit in 16 bytes");
+
+#else
+
 /**
  * @class Process
  * @brief Represents a process in the system.
@@ -26,7 +394,10 @@ public:
                 start(ULONG_MAX),
                 end(0),
                 waiting_time(0),
-                context_changes(0) {}
+                last_interrupt(0),
+                context_changes(0),
+                io_time(0),
+                next_burst(0) {}
 
     Process(unsigned long pid_,
             unsigned long duration_,
@@ -40,7 +411,29 @@ public:
                                             start(ULONG_MAX),
                                             end(0),
                                             waiting_time(0),
-                                            context_changes(0) {}
+                                            last_interrupt(0),
+                                            context_changes(0),
+                                            io_time(0),
+                                            next_burst(0) {}
+
+    /**
+     * @brief Restores a process saved with get_snapshot.
+     */
+    explicit Process(const ProcessSnapshot& snapshot) :
+        pid(snapshot.pid),
+        duration(snapshot.duration),
+        priority(snapshot.priority),
+        creation_time(snapshot.creation_time),
+        total_execution_time(snapshot.total_execution_time),
+        state(snapshot.state),
+        start(snapshot.start),
+        end(snapshot.end),
+        waiting_time(snapshot.waiting_time),
+        last_interrupt(snapshot.last_interrupt),
+        context_changes(snapshot.context_changes),
+        io_time(snapshot.io_time),
+        bursts(snapshot.bursts),
+        next_burst(snapshot.next_burst) {}
 
     ~Process() {}
 
@@ -52,23 +445,91 @@ public:
     }
 
     /**
-     * @return True if the process has finished its execution. Otherwise
-     * returns false.
+     * @brief Increments the total execution time of the process by several
+     * seconds at once.
+     */
+    void run(unsigned long seconds) {
+        total_execution_time += seconds;
+    }
+
+    /**
+     * @return True if the process has finished its current CPU burst.
+     * Otherwise returns false.
      */
     bool is_done() {
         return total_execution_time >= duration;
     }
 
+    /**
+     * @brief Sets the bursts that follow the first CPU burst: I/O and CPU
+     * burst durations, alternately, starting with an I/O burst.
+     */
+    void set_bursts(const std::vector<unsigned long>& bursts_) {
+        bursts = bursts_;
+        next_burst = 0;
+    }
+
+    /**
+     * @return True if the process blocks for I/O when its current CPU burst
+     * is done, instead of finishing.
+     */
+    bool has_io() const {
+        return next_burst + 1 < bursts.size();
+    }
+
+    /**
+     * @return The duration of the I/O burst that follows the current CPU
+     * burst.
+     */
+    unsigned long get_io_duration() const {
+        return bursts[next_burst];
+    }
+
+    /**
+     * @brief Moves to the CPU burst that follows the current I/O burst. The
+     * duration and the execution time now refer to that burst.
+     */
+    void next_cpu_burst() {
+        duration = bursts[next_burst + 1];
+        total_execution_time = 0;
+        next_burst += 2;
+    }
+
+    /**
+     * @brief Starts a new CPU burst of the given duration.
+     */
+    void start_burst(unsigned long duration_) {
+        duration = duration_;
+        total_execution_time = 0;
+    }
+
+    /**
+     * @brief Adds seconds to the current CPU burst.
+     */
+    void extend_burst(unsigned long seconds) {
+        duration += seconds;
+    }
+
+    /**
+     * @brief Changes the priority of the process. It must not be in a ready
+     * queue, which is ordered by priority.
+     */
+    void set_priority(unsigned long priority_) {
+        priority = priority_;
+    }
+
     /**
      * @brief Sets the state of the process.
      * 
-     * @param s The state of the process, being 1 for READY, 2 for RUNNING and
-     * 3 for DONE.
+     * @param s The state of the process, being 1 for READY, 2 for RUNNING,
+     * 3 for DONE and 4 for BLOCKED.
      */
     void set_state(unsigned long state_, unsigned long current_time) {
         switch (state_)
         {
         case READY:
+            if (state == BLOCKED)
+                io_time += current_time - last_interrupt;
             state = READY;
             last_interrupt = current_time;
             break;
@@ -84,6 +545,10 @@ public:
             state = DONE;
             end = current_time;
             break;
+        case BLOCKED:
+            state = BLOCKED;
+            last_interrupt = current_time;
+            break;
         default:
             break;
         }
@@ -93,7 +558,14 @@ public:
      * @return The state mneumonic of the process.
      */
     std::string get_state() {
-        switch (state)
+        return state_mnemonic(state);
+    }
+
+    /**
+     * @return The state mneumonic of a state, as printed in the timeline.
+     */
+    static const char* state_mnemonic(unsigned long state_) {
+        switch (state_)
         {
         case READY:
             return "--";
@@ -101,16 +573,28 @@ public:
         case RUNNING:
             return "##";
             break;
+        case SWITCHING:
+            return "~~";
+            break;
         case
             DONE:
             return "  ";
             break;
+        case BLOCKED:
+            return "..";
+            break;
         default:
             return "  ";
             break;
         }
     }
 
+    /**
+     * @brief Returns the current state of the process (see States).
+     */
+    unsigned long get_state_id() const {
+        return state;}
+
     /**
      * @brief Returns the process ID.
      */
@@ -131,6 +615,12 @@ public:
     unsigned long get_priority() const {
         return priority;}
 
+    /**
+     * @brief Returns the creation time of the process.
+     */
+    unsigned long get_creation_time() const {
+        return creation_time;}
+
     /**
      * @brief Returns the total execution time of the process.
      */
@@ -167,6 +657,26 @@ public:
     unsigned long get_context_changes() const {
         return context_changes;}
 
+    /**
+     * @brief Returns the time the process spent blocked on I/O.
+     */
+    unsigned long get_io_time() const {
+        return io_time;}
+
+    /**
+     * @brief Returns the time the process last became ready or blocked.
+     */
+    unsigned long get_last_interrupt() const {
+        return last_interrupt;}
+
+    /**
+     * @return Every field of the process, to save the state of a simulation.
+     */
+    ProcessSnapshot get_snapshot() const {
+        return {pid, duration, priority, creation_time, total_execution_time,
+                state, start, end, waiting_time, last_interrupt,
+                context_changes, io_time, bursts, next_burst};
+    }
 
 protected:
     unsigned long   pid;
@@ -180,6 +690,11 @@ protected:
     unsigned long   waiting_time;
     unsigned long   last_interrupt;
     unsigned long   context_changes;
+    unsigned long   io_time;
+    std::vector<unsigned long> bursts;
+    unsigned long   next_burst;
 };
 
+#endif // COMPACT_PROCESS
+
 #endif // PROCESS_H
\ No newline at end of file
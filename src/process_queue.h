@@ -1,7 +1,10 @@
 #ifndef PROCESS_QUEUE_H
 #define PROCESS_QUEUE_H
 
-#include <queue>
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <vector>
 #include "process.h"
 
 class ProcessQueueWrapper {
@@ -17,6 +20,43 @@ public:
     virtual bool empty() = 0;
 
     virtual std::size_t size() = 0;
+
+    /**
+     * @brief Moves every process of the queue to the end of processes, in no
+     * particular order, and leaves the queue empty.
+     */
+    virtual void take_all(std::vector<Process*>& processes) = 0;
+
+    /**
+     * @brief Pushes every process of processes at once. Processes with equal
+     * keys may come out in another order than if they were pushed one by one.
+     */
+    virtual void push_range(const std::vector<Process*>& processes) {
+        for (Process* process : processes)
+            push(process);
+    }
+
+    /**
+     * @brief Pushes the processes with the same result as pushing them one by
+     * one, in order. Queues that can do that faster than push override it.
+     */
+    virtual void push_in_order(const std::vector<Process*>& processes) {
+        for (Process* process : processes)
+            push(process);
+    }
+
+    /**
+     * @brief Appends the processes of the queue to processes in the order
+     * they are stored, leaving the queue as it is.
+     */
+    virtual void copy_to(std::vector<Process*>& processes) = 0;
+
+    /**
+     * @brief Replaces the queue with processes, stored in that order, as
+     * returned by copy_to. Restores a queue exactly, including the order of
+     * processes with equal keys.
+     */
+    virtual void assign(const std::vector<Process*>& processes) = 0;
 };
 
 class ProcessQueue : public ProcessQueueWrapper {
@@ -24,7 +64,7 @@ public:
     ~ProcessQueue() {}
 
     void push(Process* process) override {
-        queue.push(process);
+        queue.push_back(process);
     }
 
     Process* front() override {
@@ -36,7 +76,7 @@ public:
 
     void pop() override {
         if (!queue.empty()) {
-            queue.pop();
+            queue.pop_front();
         }
     }
 
@@ -48,43 +88,189 @@ public:
         return queue.size();
     }
 
+    void take_all(std::vector<Process*>& processes) override {
+        processes.insert(processes.end(), queue.begin(), queue.end());
+        queue.clear();
+    }
+
+    void copy_to(std::vector<Process*>& processes) override {
+        processes.insert(processes.end(), queue.begin(), queue.end());
+    }
+
+    void assign(const std::vector<Process*>& processes) override {
+        queue.assign(processes.begin(), processes.end());
+    }
+
 private:
-    std::queue<Process*> queue;
+    std::deque<Process*> queue;
 };
 
+/**
+ * @class PriorityProcessQueue
+ * @brief Binary heap of processes ordered by Comparator. It pushes and pops as
+ * std::priority_queue does, so processes with equal keys come out in the same
+ * order, but keeps the heap in a vector of its own so the whole queue can be
+ * moved out and a whole set of processes heapified at once.
+ */
 template <typename Comparator>
 class PriorityProcessQueue : public ProcessQueueWrapper {
 private:
-    std::priority_queue<Process*, std::vector<Process*>, Comparator> queue;
+    std::vector<Process*> heap;
+    Comparator comparator;
 
 public:
-    PriorityProcessQueue(const Comparator& c) : queue(c) {}
+    PriorityProcessQueue(const Comparator& c) : comparator(c) {}
 
     ~PriorityProcessQueue() {}
 
     void push(Process* process) override {
-        queue.push(process);
+        heap.push_back(process);
+        std::push_heap(heap.begin(), heap.end(), comparator);
     }
 
     Process* front() override {
-        if (!queue.empty()) {
-            return queue.top();
+        if (!heap.empty()) {
+            return heap.front();
         }
         return nullptr; // Return nullptr if the queue is empty
     }
 
     void pop() override {
-        if (!queue.empty()) {
-            queue.pop();
+        if (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), comparator);
+            heap.pop_back();
         }
     }
 
     bool empty() override {
-        return queue.empty();
+        return heap.empty();
     }
 
     std::size_t size() override {
-        return queue.size();
+        return heap.size();
+    }
+
+    void take_all(std::vector<Process*>& processes) override {
+        processes.insert(processes.end(), heap.begin(), heap.end());
+        heap.clear();
+    }
+
+    /**
+     * @brief Appends the processes and heapifies the whole queue, in O(n)
+     * instead of the O(n log n) of n pushes.
+     */
+    void push_range(const std::vector<Process*>& processes) override {
+        heap.insert(heap.end(), processes.begin(), processes.end());
+        std::make_heap(heap.begin(), heap.end(), comparator);
+    }
+
+    void copy_to(std::vector<Process*>& processes) override {
+        processes.insert(processes.end(), heap.begin(), heap.end());
+    }
+
+    void assign(const std::vector<Process*>& processes) override {
+        heap = processes;
+    }
+};
+
+/**
+ * @class AgingProcessQueue
+ * @brief Priority queue in which a waiting process gains one priority level
+ * every period seconds since it became ready.
+ *
+ * The effective priority of a process ready since r is, at time t,
+ * priority + (t - r) / period. All waiting processes age at the same rate, so
+ * their order does not depend on t: it is the order of the key
+ * priority * period - r, fixed when the process is pushed, and the global
+ * offset t only matters to compare a waiting process with one that is not
+ * waiting (see effective_key). Aging costs nothing per second and the heap
+ * never has to be reordered.
+ */
+class AgingProcessQueue : public ProcessQueueWrapper {
+public:
+    AgingProcessQueue(unsigned long period_) : period(period_) {}
+
+    ~AgingProcessQueue() {}
+
+    void push(Process* process) override {
+        heap.push_back({key(process), process});
+        std::push_heap(heap.begin(), heap.end(), Compare());
+    }
+
+    Process* front() override {
+        if (!heap.empty()) {
+            return heap.front().process;
+        }
+        return nullptr; // Return nullptr if the queue is empty
+    }
+
+    void pop() override {
+        if (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), Compare());
+            heap.pop_back();
+        }
+    }
+
+    bool empty() override {
+        return heap.empty();
+    }
+
+    std::size_t size() override {
+        return heap.size();
+    }
+
+    void take_all(std::vector<Process*>& processes) override {
+        copy_to(processes);
+        heap.clear();
+    }
+
+    void copy_to(std::vector<Process*>& processes) override {
+        for (const Entry& entry : heap)
+            processes.push_back(entry.process);
+    }
+
+    void assign(const std::vector<Process*>& processes) override {
+        heap.clear();
+        for (Process* process : processes)
+            heap.push_back({key(process), process});
+    }
+
+    /**
+     * @return The key of the front process, or INT64_MIN if the queue is
+     * empty. Its effective priority at time t, times period, is key + t.
+     */
+    int64_t front_key() const {
+        return heap.empty() ? INT64_MIN : heap.front().key;
+    }
+
+    /**
+     * @return The effective priority of a process that is not waiting, in
+     * the units of front_key.
+     */
+    int64_t effective_key(const Process* process) const {
+        return static_cast<int64_t>(process->get_priority() * period);
+    }
+
+private:
+    struct Entry {
+        int64_t key;
+        Process* process;
+    };
+
+    struct Compare {
+        bool operator()(const Entry& lhs, const Entry& rhs) const {
+            return lhs.key < rhs.key;
+        }
+    };
+
+    unsigned long period;
+    std::vector<Entry> heap;
+
+    // A process is pushed when it becomes ready, so it waits since its last
+    // interrupt.
+    int64_t key(const Process* process) const {
+        return static_cast<int64_t>(process->get_priority() * period) -
+               static_cast<int64_t>(process->get_last_interrupt());
     }
 };
 
@@ -0,0 +1,402 @@
+#ifndef PROGRAM_H
+#define PROGRAM_H
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <new>
+#include <vector>
+#include "process.h"
+#include "transition.h"
+
+/**
+ * @class FramePool
+ * @brief Allocator of coroutine frames. Frames are rounded up to a multiple
+ * of 64 bytes and kept in a free list per size, so creating and finishing
+ * millions of programs does not go through the general purpose allocator.
+ * Frames larger than MAX_POOLED are allocated normally. Each thread has its
+ * own free lists, so simulations with programs may run on several threads,
+ * and its blocks are freed when it exits; a frame must be released by the
+ * thread that allocated it, before that thread exits.
+ */
+class FramePool {
+public:
+    static void* allocate(std::size_t size) {
+        if (size > MAX_POOLED)
+            return ::operator new(size);
+        Lists& lists = thread_lists();
+        FreeFrame*& free_list = lists.free[size_class(size)];
+        if (!free_list) {
+            std::size_t frame_size = (size_class(size) + 1) * GRANULARITY;
+            char* block = static_cast<char*>(
+                ::operator new(frame_size * BLOCK_FRAMES));
+            lists.blocks.push_back(block);
+            for (std::size_t i = 0; i < BLOCK_FRAMES; i++)
+                push(free_list, block + i * frame_size);
+        }
+        FreeFrame* frame = free_list;
+        free_list = frame->next;
+        return frame;
+    }
+
+    static void release(void* frame, std::size_t size) {
+        if (size > MAX_POOLED)
+            ::operator delete(frame);
+        else
+            push(thread_lists().free[size_class(size)], frame);
+    }
+
+private:
+    static constexpr std::size_t GRANULARITY = 64;
+    static constexpr std::size_t MAX_POOLED = 1024;
+    static constexpr std::size_t BLOCK_FRAMES = 256;
+
+    struct FreeFrame {
+        FreeFrame* next;
+    };
+
+    static std::size_t size_class(std::size_t size) {
+        return (size + GRANULARITY - 1) / GRANULARITY - 1;
+    }
+
+    // The free lists of a thread and the blocks their frames come from.
+    struct Lists {
+        FreeFrame* free[MAX_POOLED / GRANULARITY] = {};
+        std::vector<char*> blocks;
+
+        ~Lists() {
+            for (char* block : blocks)
+                ::operator delete(block);
+        }
+    };
+
+    static Lists& thread_lists() {
+        thread_local Lists lists;
+        return lists;
+    }
+
+    static void push(FreeFrame*& free_list, void* frame) {
+        FreeFrame* free_frame = static_cast<FreeFrame*>(frame);
+        free_frame->next = free_list;
+        free_list = free_frame;
+    }
+};
+
+class ProgramRunner;
+
+/**
+ * @class Program
+ * @brief Coroutine that describes what a simulated process does. A program
+ * co_awaits CPU time (compute) and I/O (io), and may yield the CPU, change its
+ * priority or spawn child processes running other programs. It is resumed by
+ * a ProgramRunner only when what it awaits is done; the scheduler policies
+ * still decide when it gets the CPU.
+ */
+class Program {
+public:
+    enum RequestType {
+        REQUEST_NONE,
+        REQUEST_COMPUTE,
+        REQUEST_IO,
+        REQUEST_YIELD
+    };
+
+    struct promise_type {
+        RequestType request = REQUEST_NONE;
+        unsigned long amount = 0;
+        Process* process = nullptr;
+        ProgramRunner* runner = nullptr;
+
+        Program get_return_object() {
+            return Program(
+                std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept {
+            return {};}
+
+        std::suspend_always final_suspend() noexcept {
+            return {};}
+
+        void return_void() {}
+
+        void unhandled_exception() {
+            std::terminate();}
+
+        static void* operator new(std::size_t size) {
+            return FramePool::allocate(size);
+        }
+
+        static void operator delete(void* frame, std::size_t size) {
+            FramePool::release(frame, size);
+        }
+    };
+
+    using Handle = std::coroutine_handle<promise_type>;
+
+    Program(Program&& other) : handle(other.handle) {
+        other.handle = nullptr;
+    }
+
+    Program(const Program&) = delete;
+
+    ~Program() {
+        if (handle)
+            handle.destroy();
+    }
+
+    /**
+     * @brief Gives up the ownership of the coroutine.
+     */
+    Handle release() {
+        Handle released = handle;
+        handle = nullptr;
+        return released;
+    }
+
+private:
+    explicit Program(Handle handle_) : handle(handle_) {}
+
+    Handle handle;
+};
+
+/**
+ * @brief Awaitable that suspends the program with a request for the runner.
+ */
+struct ProgramRequest {
+    Program::RequestType type;
+    unsigned long amount;
+
+    bool await_ready() const noexcept {
+        return false;}
+
+    void await_suspend(Program::Handle handle) const noexcept {
+        handle.promise().request = type;
+        handle.promise().amount = amount;
+    }
+
+    void await_resume() const noexcept {}
+};
+
+/**
+ * @brief Uses the CPU for the given seconds. Consecutive computations are a
+ * single CPU burst.
+ */
+inline ProgramRequest compute(unsigned long seconds) {
+    return {Program::REQUEST_COMPUTE, seconds};
+}
+
+/**
+ * @brief Blocks for I/O, or sleeps, for the given seconds.
+ */
+inline ProgramRequest io(unsigned long seconds) {
+    return {Program::REQUEST_IO, seconds};
+}
+
+/**
+ * @brief Gives up the CPU: the next computation is a new CPU burst that goes
+ * through the ready queue.
+ */
+inline ProgramRequest yield_cpu() {
+    return {Program::REQUEST_YIELD, 0};
+}
+
+/**
+ * @brief Awaitable that changes the priority of the process, without
+ * suspending the program.
+ */
+struct SetPriority {
+    unsigned long priority;
+
+    bool await_ready() const noexcept {
+        return false;}
+
+    bool await_suspend(Program::Handle handle) const noexcept;
+
+    void await_resume() const noexcept {}
+};
+
+inline SetPriority set_priority(unsigned long priority) {
+    return {priority};
+}
+
+/**
+ * @brief Awaitable that creates a child process running a program, without
+ * suspending the parent.
+ */
+struct Spawn {
+    Program child;
+    unsigned long priority;
+
+    bool await_ready() const noexcept {
+        return false;}
+
+    bool await_suspend(Program::Handle handle) noexcept;
+
+    void await_resume() const noexcept {}
+};
+
+inline Spawn spawn(Program child, unsigned long priority) {
+    return {std::move(child), priority};
+}
+
+/**
+ * @class ProgramRunner
+ * @brief Runs the programs of the processes of a simulation.
+ *
+ * The kernel starts the program of a process when it is created and resumes
+ * it when its I/O is done; the scheduler asks it what a process does at the
+ * end of each CPU burst. In between, a program costs nothing. Children
+ * spawned by the programs wait in take_spawned until the kernel creates them.
+ */
+class ProgramRunner : public BurstObserver {
+public:
+    enum Step {
+        STEP_COMPUTE,   // The process starts a CPU burst
+        STEP_IO,        // The process blocks for io_duration seconds
+        STEP_EXIT       // The program is over
+    };
+
+    // A child process waiting to be created.
+    struct Child {
+        Program::Handle handle;
+        unsigned long priority;
+    };
+
+    ProgramRunner() : priority_changed(false) {}
+
+    ~ProgramRunner() {
+        for (Slot& slot : slots) {
+            if (slot.handle)
+                slot.handle.destroy();
+        }
+        for (Child& child : spawned)
+            child.handle.destroy();
+    }
+
+    /**
+     * @brief Makes program the program of a process.
+     */
+    void attach(Process* process, Program program) {
+        attach(process, program.release());
+    }
+
+    void attach(Process* process, Program::Handle handle) {
+        handle.promise().process = process;
+        handle.promise().runner = this;
+        if (process->get_pid() >= slots.size())
+            slots.resize(process->get_pid() + 1);
+        slots[process->get_pid()] = {handle, 0};
+    }
+
+    /**
+     * @brief Resumes the program of a process that is not on the CPU, on its
+     * creation or when its I/O is done. Starts its next CPU burst, if any.
+     */
+    Step resume(Process* process) {
+        bool yielded;
+        switch (next_request(*process, yielded)) {
+        case Program::REQUEST_COMPUTE:
+            process->start_burst(slots[process->get_pid()].amount);
+            return STEP_COMPUTE;
+        case Program::REQUEST_IO:
+            return STEP_IO;
+        default:
+            return STEP_EXIT;
+        }
+    }
+
+    BurstEnd on_burst_end(Process& process,
+                          unsigned long current_time) override {
+        (void)current_time;
+        bool yielded;
+        unsigned long amount;
+        switch (next_request(process, yielded)) {
+        case Program::REQUEST_COMPUTE:
+            amount = slots[process.get_pid()].amount;
+            if (yielded) {
+                process.start_burst(amount);
+                return BURST_YIELDED;
+            }
+            process.extend_burst(amount);
+            return BURST_EXTENDED;
+        case Program::REQUEST_IO:
+            return BURST_BLOCKED;
+        default:
+            return BURST_FINISHED;
+        }
+    }
+
+    /**
+     * @return The duration of the I/O a process blocked for.
+     */
+    unsigned long io_duration(const Process* process) const {
+        return slots[process->get_pid()].amount;
+    }
+
+    void take_spawned(std::vector<Child>& children) {
+        children.swap(spawned);
+        spawned.clear();
+    }
+
+    /**
+     * @return True if a program changed its priority since the last call, so
+     * a preemptive policy may have to reconsider the running process.
+     */
+    bool take_priority_change() {
+        bool changed = priority_changed;
+        priority_changed = false;
+        return changed;
+    }
+
+private:
+    struct Slot {
+        Program::Handle handle;
+        unsigned long amount;   // Seconds of the last request
+    };
+
+    std::vector<Slot> slots;
+    std::vector<Child> spawned;
+    bool priority_changed;
+
+    friend struct SetPriority;
+    friend struct Spawn;
+
+    // Resumes a program until it requests CPU time or I/O, or is over.
+    // Requests of zero seconds take no time and are skipped.
+    Program::RequestType next_request(Process& process, bool& yielded) {
+        Slot& slot = slots[process.get_pid()];
+        yielded = false;
+        while (slot.handle) {
+            slot.handle.resume();
+            if (slot.handle.done()) {
+                slot.handle.destroy();
+                slot.handle = nullptr;
+                break;
+            }
+            Program::promise_type& promise = slot.handle.promise();
+            if (promise.request == Program::REQUEST_YIELD) {
+                yielded = true;
+                continue;
+            }
+            if (!promise.amount)
+                continue;
+            slot.amount = promise.amount;
+            return promise.request;
+        }
+        return Program::REQUEST_NONE;
+    }
+};
+
+inline bool SetPriority::await_suspend(Program::Handle handle) const noexcept {
+    handle.promise().process->set_priority(priority);
+    handle.promise().runner->priority_changed = true;
+    return false;
+}
+
+inline bool Spawn::await_suspend(Program::Handle handle) noexcept {
+    handle.promise().runner->spawned.push_back({child.release(), priority});
+    return false;
+}
+
+#endif // PROGRAM_H
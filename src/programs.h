@@ -0,0 +1,85 @@
+#ifndef PROGRAMS_H
+#define PROGRAMS_H
+
+#include <string>
+#include <vector>
+#include "program.h"
+#include "read_file.h"
+
+/**
+ * @brief Computes the duration of the process, then waits for the I/O and
+ * computes the CPU bursts of the input, alternately. Behaves exactly as a
+ * process of the workload without a program.
+ */
+inline Program bursts_program(unsigned long duration,
+                              std::vector<unsigned long> bursts) {
+    co_await compute(duration);
+    for (std::size_t i = 0; i + 1 < bursts.size(); i += 2) {
+        co_await io(bursts[i]);
+        co_await compute(bursts[i + 1]);
+    }
+}
+
+/**
+ * @brief Runs duration bursts of one second, each followed by five seconds of
+ * I/O, like a process waiting for user input.
+ */
+inline Program interactive_program(unsigned long duration) {
+    for (unsigned long i = 0; i < duration; i++) {
+        co_await compute(1);
+        co_await io(5);
+    }
+}
+
+/**
+ * @brief Computes for a second and splits the rest of the work between two
+ * children with the same priority, down to pieces of two seconds. A single
+ * process of duration d becomes a tree of about d processes.
+ */
+inline Program fork_program(unsigned long duration, unsigned long priority) {
+    if (duration <= 2) {
+        co_await compute(duration);
+        co_return;
+    }
+    co_await compute(1);
+    unsigned long half = (duration - 1) / 2;
+    co_await spawn(fork_program(half, priority), priority);
+    co_await spawn(fork_program(duration - 1 - half, priority), priority);
+}
+
+/**
+ * @brief Computes half of its duration, lowers its priority by one and yields
+ * the CPU before computing the rest.
+ */
+inline Program nice_program(unsigned long duration, unsigned long priority) {
+    co_await compute(duration - duration / 2);
+    co_await set_priority(priority ? priority - 1 : 0);
+    co_await yield_cpu();
+    co_await compute(duration / 2);
+}
+
+/**
+ * @class ProgramLibrary
+ * @brief The programs that can be given to the processes of a workload with
+ * --program=<name>. Each process runs the program with its own parameters.
+ */
+class ProgramLibrary {
+public:
+    static bool exists(const std::string& name) {
+        return name == "bursts" || name == "interactive" ||
+               name == "fork" || name == "nice";
+    }
+
+    static Program create(const std::string& name,
+                          const ProcessParams& params) {
+        if (name == "interactive")
+            return interactive_program(params.get_duration());
+        if (name == "fork")
+            return fork_program(params.get_duration(), params.get_priority());
+        if (name == "nice")
+            return nice_program(params.get_duration(), params.get_priority());
+        return bursts_program(params.get_duration(), params.get_bursts());
+    }
+};
+
+#endif // PROGRAMS_H
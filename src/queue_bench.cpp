@@ -0,0 +1,377 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <linux/perf_event.h>
+#include <malloc.h>
+#include <new>
+#include <random>
+#include <string>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+#include "group_queue.h"
+#include "pairing_queue.h"
+#include "process_queue.h"
+#include "simulation.h"
+
+/**
+ * @file queue_bench.cpp
+ * @brief Micro-benchmark of the ready queues (see ProcessQueueWrapper).
+ *
+ * The operations on the ready queue of FCFS, SJF, PP and Round Robin are
+ * recorded from simulations of a generated workload, through the state
+ * changes of its processes: an arrival pushes a process, a dispatch takes the
+ * front one, a preemption pushes the running process back and a process that
+ * finishes leaves. Each queue that can serve the policy is then filled with
+ * processes up to each depth, from 10 to --max-depth, and replays the
+ * recorded operations over and over on top of them. For each depth the
+ * benchmark reports the time and the cache misses per operation, the latter
+ * from perf_event_open when the system allows it, and the bytes the queue
+ * allocated per process it holds.
+ */
+
+// Bytes allocated and not yet freed, for the memory per element.
+static std::size_t allocated_bytes = 0;
+
+void* operator new(std::size_t size) {
+    void* memory = std::malloc(size ? size : 1);
+    if (!memory)
+        throw std::bad_alloc();
+    allocated_bytes += malloc_usable_size(memory);
+    return memory;
+}
+
+void operator delete(void* memory) noexcept {
+    if (!memory)
+        return;
+    allocated_bytes -= malloc_usable_size(memory);
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    operator delete(memory);
+}
+
+enum QueueOperation {
+    OP_ARRIVE,      // Pushes a process that was not in the queue
+    OP_DISPATCH,    // Takes the front process to the CPU
+    OP_REINSERT,    // Pushes the running process back
+    OP_FINISH       // The running process leaves, without touching the queue
+};
+
+/**
+ * @class OperationRecorder
+ * @brief Records the operations of a ready queue from the state changes of
+ * the processes of a simulation.
+ */
+class OperationRecorder : public SimulationObserver {
+public:
+    OperationRecorder() : depth(0), depth_sum(0) {}
+
+    ~OperationRecorder() {}
+
+    void on_transition(unsigned long pid,
+                       unsigned long from,
+                       unsigned long to,
+                       unsigned long current_time) override {
+        (void)pid;
+        (void)current_time;
+        if (to == READY) {
+            operations.push_back(from == RUNNING ? OP_REINSERT : OP_ARRIVE);
+            depth++;
+        } else if (from == READY && to == RUNNING) {
+            operations.push_back(OP_DISPATCH);
+            depth--;
+        } else if (from == RUNNING && to == DONE) {
+            operations.push_back(OP_FINISH);
+        } else {
+            return;
+        }
+        depth_sum += depth;
+    }
+
+    /**
+     * @return The mean depth of the queue over the operations.
+     */
+    double mean_depth() const {
+        return operations.empty() ? 0 :
+               static_cast<double>(depth_sum) / operations.size();
+    }
+
+    std::vector<unsigned char> operations;
+
+private:
+    unsigned long depth;
+    unsigned long depth_sum;
+};
+
+/**
+ * @class CacheMissCounter
+ * @brief Counts the cache misses of the process with perf_event_open. Not
+ * available if the system does not allow it, as in most containers.
+ */
+class CacheMissCounter {
+public:
+    CacheMissCounter() {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+    ~CacheMissCounter() {
+        if (fd >= 0)
+            close(fd);
+    }
+
+    bool available() const {
+        return fd >= 0;
+    }
+
+    void start() {
+        if (fd < 0)
+            return;
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    uint64_t stop() {
+        uint64_t misses = 0;
+        if (fd < 0)
+            return 0;
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(fd, &misses, sizeof(misses)) != sizeof(misses))
+            return 0;
+        return misses;
+    }
+
+private:
+    int fd;
+};
+
+// The orders of the keyed queues of SJF and PP, as in the schedulers.
+struct ShortestFirst {
+    bool operator()(Process* const& p1, Process* const& p2) {
+        return p1->get_duration() > p2->get_duration();
+    }
+};
+
+struct HighestPriority {
+    bool operator()(Process* const& p1, Process* const& p2) {
+        return p1->get_priority() < p2->get_priority();
+    }
+};
+
+struct Mix {
+    std::string name;
+    unsigned long scheduler_type;
+    bool keyed;                 // Ordered by a key rather than first in,
+                                // first out
+    bool by_priority;           // The key is the priority, not the duration
+    OperationRecorder recorder;
+};
+
+// Seconds per priority level of the aging queue, as with --aging=5. The
+// processes of the benchmark never wait since a later time than others, so
+// it orders them by priority alone.
+static const unsigned long AGING_PERIOD = 5;
+
+/**
+ * @return The number of queues that can serve the policy of the mix.
+ */
+static unsigned long queue_count(const Mix& mix) {
+    return !mix.keyed ? 2 : mix.by_priority ? 3 : 2;
+}
+
+static ProcessQueueWrapper* create_queue(const Mix& mix, unsigned long queue) {
+    if (!mix.keyed) {
+        if (queue == 0)
+            return new ProcessQueue();
+        return new GroupQueue();
+    }
+    if (queue == 0)
+        return mix.by_priority ?
+               static_cast<ProcessQueueWrapper*>(
+                   new PriorityProcessQueue<HighestPriority>(HighestPriority())) :
+               new PriorityProcessQueue<ShortestFirst>(ShortestFirst());
+    if (queue == 1)
+        return mix.by_priority ?
+               static_cast<ProcessQueueWrapper*>(
+                   new PairingProcessQueue<HighestPriority>(HighestPriority())) :
+               new PairingProcessQueue<ShortestFirst>(ShortestFirst());
+    return new AgingProcessQueue(AGING_PERIOD);
+}
+
+static std::string queue_name(const Mix& mix, unsigned long queue) {
+    if (!mix.keyed)
+        return queue == 0 ? "deque" : "group";
+    return queue == 0 ? "binary heap" : queue == 1 ? "pairing heap" : "aging";
+}
+
+/**
+ * @brief Fills a queue up to depth and replays the operations of the mix
+ * on it, and prints the results.
+ */
+static void run(const Mix& mix, unsigned long queue, std::size_t depth,
+                std::size_t operation_count,
+                const std::vector<ProcessSpec>& workload,
+                CacheMissCounter& misses) {
+    // Every process that may be queued at once, with the keys of the
+    // processes of the workload. The processes not in the queue nor running
+    // are free, and each arrival takes one.
+    std::size_t pool_size = depth + workload.size() + 1;
+    std::vector<Process> processes;
+    processes.reserve(pool_size);
+    for (std::size_t i = 0; i < pool_size; i++) {
+        const ProcessSpec& spec = workload[i % workload.size()];
+        processes.emplace_back(i + 1, spec.duration, spec.priority, 0);
+    }
+    std::vector<Process*> free_processes;
+    free_processes.reserve(pool_size);
+    for (std::size_t i = pool_size; i > 0; i--)
+        free_processes.push_back(&processes[i - 1]);
+
+    std::size_t before = allocated_bytes;
+    ProcessQueueWrapper* ready = create_queue(mix, queue);
+    for (std::size_t i = 0; i < depth; i++) {
+        ready->push(free_processes.back());
+        free_processes.pop_back();
+    }
+    double bytes = static_cast<double>(allocated_bytes - before) / depth;
+
+    const std::vector<unsigned char>& operations = mix.recorder.operations;
+    Process* running = nullptr;
+    std::size_t next = 0;
+    auto start = std::chrono::steady_clock::now();
+    misses.start();
+    for (std::size_t i = 0; i < operation_count; i++) {
+        switch (operations[next]) {
+        case OP_ARRIVE:
+            ready->push(free_processes.back());
+            free_processes.pop_back();
+            break;
+        case OP_DISPATCH:
+            running = ready->front();
+            ready->pop();
+            break;
+        case OP_REINSERT:
+            ready->push(running);
+            running = nullptr;
+            break;
+        default:
+            free_processes.push_back(running);
+            running = nullptr;
+            break;
+        }
+        if (++next == operations.size())
+            next = 0;
+    }
+    uint64_t miss_count = misses.stop();
+    double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    delete ready;
+
+    std::cout << std::left << std::setw(6) << mix.name
+              << std::setw(14) << queue_name(mix, queue)
+              << std::right << std::setw(10) << depth
+              << std::fixed << std::setprecision(1)
+              << std::setw(10) << seconds * 1e9 / operation_count;
+    if (misses.available())
+        std::cout << std::setw(12) << std::setprecision(3)
+                  << static_cast<double>(miss_count) / operation_count;
+    else
+        std::cout << std::setw(12) << "n/a";
+    std::cout << std::setw(12) << std::setprecision(1) << bytes << std::endl;
+}
+
+/**
+ * @brief Generates a workload that keeps the CPU busy about 90% of the time,
+ * so the recorded queues stay shallow and the depth is the one of the run.
+ */
+static std::vector<ProcessSpec> generate_workload(unsigned long count) {
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int> duration(1, 20);
+    std::uniform_int_distribution<int> priority(1, 10);
+    std::exponential_distribution<double> gap(0.9 / 10.5);
+    std::vector<ProcessSpec> workload(count);
+    double creation = 0;
+    for (ProcessSpec& process : workload) {
+        process.creation_time = static_cast<unsigned long>(creation);
+        process.duration = duration(random);
+        process.priority = priority(random);
+        creation += gap(random);
+    }
+    return workload;
+}
+
+int main(int argc, char** argv) {
+    std::size_t max_depth = 10000000;
+    std::size_t operation_count = 1000000;
+    unsigned long process_count = 100000;
+    for (int i = 1; i < argc; i++) {
+        std::string argument(argv[i]);
+        if (argument.rfind("--max-depth=", 0) == 0) {
+            max_depth = std::strtoul(argument.c_str() + 12, nullptr, 10);
+        } else if (argument.rfind("--ops=", 0) == 0) {
+            operation_count = std::strtoul(argument.c_str() + 6, nullptr, 10);
+        } else if (argument.rfind("--processes=", 0) == 0) {
+            process_count = std::strtoul(argument.c_str() + 12, nullptr, 10);
+        } else {
+            std::cout << "Usage: ./queue_bench [--max-depth=<processes>] "
+                         "[--ops=<operations>] [--processes=<processes>]"
+                      << std::endl;
+            return 1;
+        }
+    }
+    if (!max_depth || !operation_count || !process_count) {
+        std::cout << "Erro: as opções precisam ser maiores que zero"
+                  << std::endl;
+        return 1;
+    }
+
+    std::vector<ProcessSpec> workload = generate_workload(process_count);
+    std::vector<Mix> mixes(4);
+    mixes[0] = {"FCFS", 1, false, false, {}};
+    mixes[1] = {"SJF", 2, true, false, {}};
+    mixes[2] = {"PP", 4, true, true, {}};
+    mixes[3] = {"RR", 5, false, false, {}};
+    for (Mix& mix : mixes) {
+        SimulationConfig config;
+        config.scheduler_type = mix.scheduler_type;
+        config.observer = &mix.recorder;
+        simulate_workload(workload, config);
+        unsigned long counts[4] = {0, 0, 0, 0};
+        for (unsigned char operation : mix.recorder.operations)
+            counts[operation]++;
+        std::cout << mix.name << " mix: " << counts[OP_ARRIVE] << " arrivals, "
+                  << counts[OP_DISPATCH] << " dispatches, "
+                  << counts[OP_REINSERT] << " reinserts, "
+                  << counts[OP_FINISH] << " finishes, mean recorded depth "
+                  << std::fixed << std::setprecision(1)
+                  << mix.recorder.mean_depth() << std::endl;
+    }
+
+    CacheMissCounter misses;
+    std::cout << std::endl << operation_count << " operations per run, "
+              << sizeof(Process) << " bytes per process (not counted in "
+                 "bytes/elem)" << std::endl
+              << std::left << std::setw(6) << "mix" << std::setw(14) << "queue"
+              << std::right << std::setw(10) << "depth" << std::setw(10)
+              << "ns/op" << std::setw(12) << "misses/op" << std::setw(12)
+              << "bytes/elem" << std::endl;
+    for (Mix& mix : mixes) {
+        for (unsigned long queue = 0; queue < queue_count(mix); queue++) {
+            for (std::size_t depth = 10; depth <= max_depth; depth *= 10)
+                run(mix, queue, depth, operation_count, workload, misses);
+        }
+    }
+    return 0;
+}
@@ -1,5 +1,10 @@
+#ifndef READ_FILE_H
+#define READ_FILE_H
+
+#include <cstdlib>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -31,11 +36,83 @@ public:
         return priority;
     }
 
+    /**
+     * @brief Returns the bursts that follow the first CPU burst: I/O and CPU
+     * burst durations, alternately. Empty if the process does no I/O.
+     */
+    const vector<unsigned long>& get_bursts() const {
+        return bursts;
+    }
+
+    void set_bursts(const vector<unsigned long>& bursts_) {
+        bursts = bursts_;
+    }
+
+    /**
+     * @brief Returns the group of the process, a path such as /web:3/api
+     * where each group may be followed by its weight. Empty if the process
+     * belongs to the root group.
+     */
+    const string& get_group() const {
+        return group;
+    }
+
+    void set_group(const string& group_) {
+        group = group_;
+    }
+
+    /**
+     * @brief Reads the next process of a workload file. Each line has the
+     * creation time, the duration and the priority, optionally followed by
+     * the group of the process (a path starting with /) and then by I/O and
+     * CPU burst durations, alternately. Bursts shorter than a second
+     * last one second, and a last I/O burst without a CPU burst after it is
+     * ignored. Lines with fewer than three numbers are skipped.
+     *
+     * @return False at the end of the file.
+     */
+    static bool read(istream& file, ProcessParams& params) {
+        string line;
+        string group;
+        vector<long> values;
+        while (getline(file, line)) {
+            values.clear();
+            group.clear();
+            istringstream numbers(line);
+            long value;
+            while (numbers >> value)
+                values.push_back(value);
+            if (values.size() == 3 && !numbers.eof()) {
+                numbers.clear();
+                if (numbers >> group && group[0] == '/') {
+                    while (numbers >> value)
+                        values.push_back(value);
+                } else {
+                    group.clear();
+                }
+            }
+            if (values.size() < 3)
+                continue;
+
+            params = ProcessParams(abs(values[0]), abs(values[1]), abs(values[2]));
+            params.group = group;
+            params.bursts.clear();
+            for (size_t i = 3; i + 1 < values.size(); i += 2) {
+                params.bursts.push_back(max(1l, labs(values[i])));
+                params.bursts.push_back(max(1l, labs(values[i + 1])));
+            }
+            return true;
+        }
+        return false;
+    }
+
 
 private:
 	unsigned long creation_time;
 	unsigned long duration; //seconds
 	unsigned long priority;
+	vector<unsigned long> bursts;
+	string group;
 };
 
 class File
@@ -51,14 +128,14 @@ public:
 	
 	void read_file() {
 	
-		int a, b, c;
+		ProcessParams params(0, 0, 0);
 		
 		if (!myfile.is_open()) {
 			cout << "Arquivo não está aberto!" << endl;
 		}
 		
-		while (myfile >> a >> b >> c) {
-			ProcessParams *p = new ProcessParams(abs(a), abs(b), abs(c));
+		while (ProcessParams::read(myfile, params)) {
+			ProcessParams *p = new ProcessParams(params);
 			processes.push_back(p);
 		}
 
@@ -89,3 +166,5 @@ private:
 	ifstream myfile; 
 	vector<ProcessParams *> processes;
 };
+
+#endif // READ_FILE_H
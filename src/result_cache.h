@@ -0,0 +1,458 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @brief Key of a cached result: a 64 bit hash that addresses it and a second,
+ * independent one that confirms the match.
+ */
+struct ResultKey {
+    uint64_t hash;
+    uint64_t check;
+};
+
+/**
+ * @class ResultHasher
+ * @brief Hashes everything a simulation output depends on: the bytes of the
+ * workload and the configuration of the run. The hash is FNV-1a and the check
+ * a multiply-rotate hash of the same bytes.
+ */
+class ResultHasher {
+public:
+    ResultHasher() : hash(FNV_OFFSET), check(CHECK_SEED), size(0) {}
+
+    void update(const void* data, std::size_t count) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        uint64_t h = hash;
+        uint64_t c = check;
+        for (std::size_t i = 0; i < count; i++) {
+            h = (h ^ bytes[i]) * FNV_PRIME;
+            c = (((c << 5) | (c >> 59)) ^ bytes[i]) * CHECK_PRIME;
+        }
+        hash = h;
+        check = c;
+        size += count;
+    }
+
+    void update(const std::string& text) {
+        update(text.data(), text.size() + 1);
+    }
+
+    void update(unsigned long value) {
+        update(&value, sizeof(value));
+    }
+
+    /**
+     * @brief Hashes the contents of a file, or its first length bytes.
+     * @return False if the file could not be read or is shorter than length.
+     */
+    bool update_file(const std::string& file_name,
+                     uint64_t length = UINT64_MAX) {
+        int fd = open(file_name.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat status;
+        bool read = fstat(fd, &status) == 0;
+        uint64_t bytes = read ? std::min<uint64_t>(status.st_size, length) : 0;
+        if (length != UINT64_MAX && bytes < length)
+            read = false;
+        if (read && bytes > 0) {
+            void* data = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+            read = data != MAP_FAILED;
+            if (read) {
+                madvise(data, bytes, MADV_SEQUENTIAL);
+                update(data, bytes);
+                munmap(data, bytes);
+            }
+        }
+        close(fd);
+        return read;
+    }
+
+    ResultKey key() const {
+        return {hash, check ^ size};
+    }
+
+private:
+    static constexpr uint64_t FNV_OFFSET = 0xcbf29ce484222325ull;
+    static constexpr uint64_t FNV_PRIME = 0x100000001b3ull;
+    static constexpr uint64_t CHECK_SEED = 0x243f6a8885a308d3ull;
+    static constexpr uint64_t CHECK_PRIME = 0x517cc1b727220a95ull;
+
+    uint64_t hash;
+    uint64_t check;
+    uint64_t size;
+};
+
+/**
+ * @class ResultCache
+ * @brief Persistent cache of the outputs of simulation runs, in a directory.
+ *
+ * Each output is stored as a file named after the hash of its key. The index
+ * is an open addressing hash table with linear probing, in a file that every
+ * process maps with mmap, so a lookup is O(1) and touches a few slots. The
+ * slots are also linked in least recently used order: when the outputs exceed
+ * the size cap, or the table is three quarters full, the least recently used
+ * ones are evicted. Every operation holds an exclusive flock on the index, so
+ * concurrent runs can share a cache.
+ *
+ * An output is captured by pointing the standard output at a new file of the
+ * cache for the whole run (see begin_capture), which is then copied to the
+ * real standard output and renamed into place.
+ */
+class ResultCache {
+public:
+    /**
+     * @brief Version of the simulation output. Results cached by other
+     * versions are never returned, so it must change whenever a change alters
+     * the output of a configuration that already existed.
+     */
+    static constexpr const char* VERSION = "4";
+
+    ResultCache(const std::string& dir_, uint64_t max_bytes_) :
+        dir(dir_),
+        max_bytes(max_bytes_),
+        index_fd(-1),
+        header(nullptr),
+        slots(nullptr),
+        capture_fd(-1),
+        saved_stdout(-1) {
+        if (!make_directories(dir)) {
+            std::cout << "Erro ao criar o diretório do cache " << dir
+                      << std::endl;
+            return;
+        }
+        index_fd = open((dir + "/index").c_str(), O_RDWR | O_CREAT, 0644);
+        if (index_fd < 0) {
+            std::cout << "Erro ao abrir o índice do cache em " << dir
+                      << std::endl;
+            return;
+        }
+        flock(index_fd, LOCK_EX);
+        struct stat status;
+        if (fstat(index_fd, &status) == 0 &&
+            (static_cast<std::size_t>(status.st_size) == INDEX_SIZE ||
+             ftruncate(index_fd, INDEX_SIZE) == 0)) {
+            void* map = mmap(nullptr, INDEX_SIZE, PROT_READ | PROT_WRITE,
+                             MAP_SHARED, index_fd, 0);
+            if (map != MAP_FAILED) {
+                header = static_cast<Header*>(map);
+                slots = reinterpret_cast<Slot*>(header + 1);
+                if (header->magic != MAGIC)
+                    reset_index();
+            }
+        }
+        flock(index_fd, LOCK_UN);
+        if (!header)
+            std::cout << "Erro ao mapear o índice do cache em " << dir
+                      << std::endl;
+    }
+
+    ~ResultCache() {
+        if (header)
+            munmap(header, INDEX_SIZE);
+        if (index_fd >= 0)
+            close(index_fd);
+    }
+
+    bool is_open() const {
+        return header != nullptr;
+    }
+
+    /**
+     * @brief If the output of key is cached, writes it to fd and marks it as
+     * the most recently used.
+     * @return True on a hit.
+     */
+    bool replay(const ResultKey& key, int fd) {
+        std::cout.flush();
+        std::fflush(stdout);
+        flock(index_fd, LOCK_EX);
+        long slot = find(key.hash);
+        int blob = -1;
+        if (slot >= 0 && slots[slot].check == key.check) {
+            // The file stays readable if another run evicts it meanwhile.
+            blob = open(blob_path(key.hash).c_str(), O_RDONLY);
+            if (blob >= 0) {
+                unlink_lru(slot);
+                push_front(slot);
+            } else {
+                remove(slot);
+            }
+        }
+        flock(index_fd, LOCK_UN);
+        if (blob < 0)
+            return false;
+        copy(blob, fd);
+        close(blob);
+        return true;
+    }
+
+    /**
+     * @brief Starts writing the standard output to a new file of the cache.
+     * @return False if the file could not be created; nothing is captured.
+     */
+    bool begin_capture() {
+        std::cout.flush();
+        std::fflush(stdout);
+        std::string pattern = dir + "/capture-XXXXXX";
+        capture_path.assign(pattern.begin(), pattern.end());
+        capture_path.push_back('\0');
+        capture_fd = mkstemp(&capture_path[0]);
+        capture_path.pop_back();
+        if (capture_fd < 0)
+            return false;
+        saved_stdout = dup(STDOUT_FILENO);
+        dup2(capture_fd, STDOUT_FILENO);
+        return true;
+    }
+
+    /**
+     * @brief Restores the standard output, writes the captured output to it
+     * and stores it under key, evicting the least recently used outputs if
+     * needed. Outputs larger than the cache are not stored.
+     */
+    void end_capture(const ResultKey& key) {
+        uint64_t size = restore_stdout();
+        flock(index_fd, LOCK_EX);
+        long slot = find(key.hash);
+        if (slot >= 0)
+            remove(slot);
+        if (size > max_bytes) {
+            unlink(capture_path.c_str());
+        } else {
+            while (header->count &&
+                   (header->total_bytes + size > max_bytes ||
+                    header->count >= MAX_ENTRIES))
+                remove(header->tail);
+            if (rename(capture_path.c_str(), blob_path(key.hash).c_str()) == 0)
+                insert(key, size);
+            else
+                unlink(capture_path.c_str());
+        }
+        flock(index_fd, LOCK_UN);
+    }
+
+    /**
+     * @brief Restores the standard output and writes the captured output to
+     * it, without storing it.
+     */
+    void cancel_capture() {
+        restore_stdout();
+        unlink(capture_path.c_str());
+    }
+
+    /**
+     * @return The default directory of the cache: $XDG_CACHE_HOME/scheduler,
+     * or ~/.cache/scheduler.
+     */
+    static std::string default_dir() {
+        const char* cache_home = std::getenv("XDG_CACHE_HOME");
+        if (cache_home && *cache_home)
+            return std::string(cache_home) + "/scheduler";
+        const char* home = std::getenv("HOME");
+        return std::string(home ? home : ".") + "/.cache/scheduler";
+    }
+
+    static const uint64_t DEFAULT_MAX_BYTES = 256ull << 20;
+
+private:
+    static constexpr uint64_t MAGIC = 0x3148434143484353ull;  // "SCHCACH1"
+    static constexpr std::size_t CAPACITY = 1 << 14;          // Power of two
+    static constexpr std::size_t MAX_ENTRIES = CAPACITY / 4 * 3;
+
+    struct Header {
+        uint64_t magic;
+        uint64_t total_bytes;   // Size of the cached outputs
+        uint32_t count;
+        int32_t head;           // Most recently used slot, or -1
+        int32_t tail;           // Least recently used slot, or -1
+        uint32_t padding;
+    };
+
+    struct Slot {
+        uint64_t hash;
+        uint64_t check;
+        uint64_t size;
+        int32_t prev;           // More recently used slot, or -1
+        int32_t next;           // Less recently used slot, or -1
+        uint32_t used;
+        uint32_t padding;
+    };
+
+    static constexpr std::size_t INDEX_SIZE =
+        sizeof(Header) + CAPACITY * sizeof(Slot);
+
+    std::string dir;
+    uint64_t max_bytes;
+    int index_fd;
+    Header* header;
+    Slot* slots;
+    std::string capture_path;
+    int capture_fd;
+    int saved_stdout;
+
+    static bool make_directories(const std::string& path) {
+        for (std::size_t slash = path.find('/', 1);
+             slash != std::string::npos;
+             slash = path.find('/', slash + 1))
+            mkdir(path.substr(0, slash).c_str(), 0755);
+        return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+    }
+
+    std::string blob_path(uint64_t hash) const {
+        char name[17];
+        std::snprintf(name, sizeof(name), "%016llx",
+                      static_cast<unsigned long long>(hash));
+        return dir + "/" + name;
+    }
+
+    // Ends the capture: points the standard output back at where it was and
+    // writes the captured output to it. Returns the size of the output.
+    uint64_t restore_stdout() {
+        std::cout.flush();
+        std::fflush(stdout);
+        dup2(saved_stdout, STDOUT_FILENO);
+        close(saved_stdout);
+        uint64_t size = lseek(capture_fd, 0, SEEK_END);
+        lseek(capture_fd, 0, SEEK_SET);
+        copy(capture_fd, STDOUT_FILENO);
+        close(capture_fd);
+        return size;
+    }
+
+    // Copies the rest of a file to fd, with sendfile when fd allows it.
+    static void copy(int from, int to) {
+        while (true) {
+            ssize_t sent = sendfile(to, from, nullptr, 1 << 30);
+            if (sent > 0)
+                continue;
+            if (sent < 0 && errno == EINTR)
+                continue;
+            if (sent == 0)
+                return;
+            break;
+        }
+        char buffer[1 << 16];
+        ssize_t n;
+        while ((n = read(from, buffer, sizeof(buffer))) > 0) {
+            for (ssize_t written = 0; written < n;) {
+                ssize_t w = write(to, buffer + written, n - written);
+                if (w < 0 && errno == EINTR)
+                    continue;
+                if (w < 0)
+                    return;
+                written += w;
+            }
+        }
+    }
+
+    void reset_index() {
+        std::memset(header, 0, INDEX_SIZE);
+        header->magic = MAGIC;
+        header->head = -1;
+        header->tail = -1;
+    }
+
+    // Home slot of a hash; probing goes on from there.
+    static std::size_t home(uint64_t hash) {
+        return hash & (CAPACITY - 1);
+    }
+
+    long find(uint64_t hash) const {
+        for (std::size_t i = home(hash); slots[i].used;
+             i = (i + 1) & (CAPACITY - 1)) {
+            if (slots[i].hash == hash)
+                return i;
+        }
+        return -1;
+    }
+
+    void insert(const ResultKey& key, uint64_t size) {
+        std::size_t i = home(key.hash);
+        while (slots[i].used)
+            i = (i + 1) & (CAPACITY - 1);
+        slots[i].hash = key.hash;
+        slots[i].check = key.check;
+        slots[i].size = size;
+        slots[i].used = 1;
+        push_front(i);
+        header->count++;
+        header->total_bytes += size;
+    }
+
+    // Removes a slot and its output. The slots of the probe sequence that
+    // follows are shifted back, so lookups need no tombstones.
+    void remove(long slot) {
+        unlink(blob_path(slots[slot].hash).c_str());
+        unlink_lru(slot);
+        header->count--;
+        header->total_bytes -= slots[slot].size;
+        std::size_t hole = slot;
+        for (std::size_t i = (hole + 1) & (CAPACITY - 1); slots[i].used;
+             i = (i + 1) & (CAPACITY - 1)) {
+            // A slot can fill the hole if the hole is between its home and
+            // the slot itself, cyclically.
+            std::size_t from_home = (i - home(slots[i].hash)) & (CAPACITY - 1);
+            std::size_t from_hole = (i - hole) & (CAPACITY - 1);
+            if (from_home < from_hole)
+                continue;
+            move(i, hole);
+            hole = i;
+        }
+        slots[hole].used = 0;
+    }
+
+    // Moves a slot to an empty one, relinking its neighbours.
+    void move(std::size_t from, std::size_t to) {
+        slots[to] = slots[from];
+        Slot& slot = slots[to];
+        if (slot.prev >= 0)
+            slots[slot.prev].next = to;
+        else
+            header->head = to;
+        if (slot.next >= 0)
+            slots[slot.next].prev = to;
+        else
+            header->tail = to;
+    }
+
+    void unlink_lru(long slot) {
+        Slot& s = slots[slot];
+        if (s.prev >= 0)
+            slots[s.prev].next = s.next;
+        else
+            header->head = s.next;
+        if (s.next >= 0)
+            slots[s.next].prev = s.prev;
+        else
+            header->tail = s.prev;
+    }
+
+    void push_front(long slot) {
+        Slot& s = slots[slot];
+        s.prev = -1;
+        s.next = header->head;
+        if (header->head >= 0)
+            slots[header->head].prev = slot;
+        else
+            header->tail = slot;
+        header->head = slot;
+    }
+};
+
+#endif // RESULT_CACHE_H
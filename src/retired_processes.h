@@ -0,0 +1,143 @@
+#ifndef RETIRED_PROCESSES_H
+#define RETIRED_PROCESSES_H
+
+#include <cstdlib>
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "simulation.h"
+
+/**
+ * @class RetiredProcesses
+ * @brief The statistics of the processes that are done, stored by pid in a
+ * temporary file of fixed size records, so the processes themselves can be
+ * freed as soon as they are done (see Options::retire). Once the run is over,
+ * the records are read back in pid order.
+ *
+ * Records of consecutive pids are written together, so a policy that
+ * finishes processes in creation order, such as FCFS, writes the file
+ * sequentially. The others write a record at a time at its place.
+ *
+ * An incremental run keeps the file next to its snapshot instead, so the
+ * records of the processes done before the snapshot are not written again
+ * by the runs that resume from it (see Kernel::start_incremental).
+ */
+class RetiredProcesses {
+public:
+    RetiredProcesses(const std::string& tmp_dir) :
+        fd(-1), good(true), buffer_pid(0), position(0), next_pid(1) {
+        std::string pattern = tmp_dir + "/scheduler-retired-XXXXXX";
+        std::vector<char> name(pattern.begin(), pattern.end());
+        name.push_back('\0');
+        fd = mkstemp(name.data());
+        if (fd < 0) {
+            std::cout << "Erro ao criar arquivo temporário em " << tmp_dir
+                      << std::endl;
+            return;
+        }
+        // Nothing else opens the file, which is removed when it is closed.
+        unlink(name.data());
+    }
+
+    /**
+     * @brief Opens or creates the file file_name, which is kept.
+     * @param truncate If true, the records already in the file are dropped.
+     */
+    RetiredProcesses(const std::string& file_name, bool truncate) :
+        fd(open(file_name.c_str(),
+                O_RDWR | O_CREAT | (truncate ? O_TRUNC : 0), 0644)),
+        good(true), buffer_pid(0), position(0), next_pid(1) {
+        if (fd < 0)
+            std::cout << "Erro ao abrir o arquivo " << file_name << std::endl;
+    }
+
+    ~RetiredProcesses() {
+        if (fd >= 0)
+            close(fd);
+    }
+
+    bool is_open() const {
+        return fd >= 0;
+    }
+
+    /**
+     * @return False if a record could not be written or read.
+     */
+    bool is_good() const {
+        return good;
+    }
+
+    void write(unsigned long pid, const ProcessRecord& record) {
+        if (!buffer.empty() && pid != buffer_pid + buffer.size())
+            flush();
+        if (buffer.empty())
+            buffer_pid = pid;
+        buffer.push_back(record);
+        if (buffer.size() == BUFFER_RECORDS)
+            flush();
+    }
+
+    /**
+     * @brief Writes the records not written yet and goes back to pid 1, to
+     * read the records. No record is written after that.
+     */
+    void rewind() {
+        flush();
+        position = 0;
+        next_pid = 1;
+    }
+
+    /**
+     * @brief Writes the records not written yet.
+     */
+    void flush() {
+        if (buffer.empty())
+            return;
+        std::size_t bytes = buffer.size() * sizeof(ProcessRecord);
+        if (fd < 0 || pwrite(fd, buffer.data(), bytes, offset(buffer_pid)) !=
+                      static_cast<ssize_t>(bytes))
+            good = false;
+        buffer.clear();
+    }
+
+    /**
+     * @brief Reads the record of the next pid.
+     * @return False if there is no such record.
+     */
+    bool read(ProcessRecord& record) {
+        if (position == buffer.size()) {
+            buffer.resize(BUFFER_RECORDS);
+            ssize_t bytes = fd < 0 ? -1 :
+                            pread(fd, buffer.data(), buffer.size() *
+                                  sizeof(ProcessRecord), offset(next_pid));
+            if (bytes < 0)
+                good = false;
+            buffer.resize(bytes > 0 ? bytes / sizeof(ProcessRecord) : 0);
+            position = 0;
+            if (buffer.empty())
+                return false;
+        }
+        record = buffer[position++];
+        next_pid++;
+        return true;
+    }
+
+private:
+    static constexpr std::size_t BUFFER_RECORDS = 4096;
+
+    int fd;
+    bool good;
+    std::vector<ProcessRecord> buffer;  // To write from buffer_pid on, or
+                                        // read
+    unsigned long buffer_pid;
+    std::size_t position;               // Of the next record to read
+    unsigned long next_pid;             // To read
+
+    static off_t offset(unsigned long pid) {
+        return static_cast<off_t>((pid - 1) * sizeof(ProcessRecord));
+    }
+};
+
+#endif // RETIRED_PROCESSES_H
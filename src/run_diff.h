@@ -0,0 +1,468 @@
+#ifndef RUN_DIFF_H
+#define RUN_DIFF_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <queue>
+#include <string>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+#include "process.h"
+#include "transition.h"
+
+/**
+ * @class TransitionLog
+ * @brief The state transitions of a run, stored in a temporary file as fixed
+ * size records, written once and then read back in order through a buffer.
+ */
+class TransitionLog {
+public:
+    struct Record {
+        uint64_t time;
+        uint64_t pid;
+        uint32_t from;
+        uint32_t to;
+        // The statistics of the process, only set on a transition to DONE.
+        uint64_t turnaround_time;
+        uint64_t waiting_time;
+        uint64_t context_changes;
+    };
+
+    TransitionLog(const std::string& tmp_dir) :
+        file(nullptr), good(false), position(0) {
+        std::string pattern = tmp_dir + "/scheduler-diff-XXXXXX";
+        std::vector<char> name(pattern.begin(), pattern.end());
+        name.push_back('\0');
+        int fd = mkstemp(name.data());
+        if (fd >= 0) {
+            path = name.data();
+            file = fdopen(fd, "w+b");
+        }
+        good = file;
+        if (!file)
+            std::cout << "Erro ao criar arquivo temporário em " << tmp_dir
+                      << std::endl;
+    }
+
+    ~TransitionLog() {
+        if (file) {
+            std::fclose(file);
+            unlink(path.c_str());
+        }
+    }
+
+    bool is_open() const {
+        return file;
+    }
+
+    /**
+     * @return False if a record could not be written, so the log misses
+     * transitions.
+     */
+    bool is_good() const {
+        return good;
+    }
+
+    void write(const Record& record) {
+        if (good && std::fwrite(&record, sizeof(record), 1, file) != 1)
+            good = false;
+    }
+
+    /**
+     * @brief Goes back to the first record, to read the log.
+     */
+    void rewind() {
+        if (!file)
+            return;
+        if (std::fflush(file) != 0)
+            good = false;
+        std::fseek(file, 0, SEEK_SET);
+        buffer.clear();
+        position = 0;
+    }
+
+    /**
+     * @return The next record, or nullptr at the end of the log.
+     */
+    const Record* peek() {
+        if (position == buffer.size()) {
+            buffer.resize(BUFFER_RECORDS);
+            buffer.resize(file ? std::fread(buffer.data(), sizeof(Record),
+                                            BUFFER_RECORDS, file) : 0);
+            position = 0;
+        }
+        return position < buffer.size() ? &buffer[position] : nullptr;
+    }
+
+    void pop() {
+        position++;
+    }
+
+private:
+    static constexpr std::size_t BUFFER_RECORDS = 4096;
+
+    std::string path;
+    FILE* file;
+    bool good;
+    std::vector<Record> buffer;
+    std::size_t position;
+};
+
+/**
+ * @class RunDiff
+ * @brief Compares two runs of the same workload from their state transitions,
+ * without keeping either one.
+ *
+ * The transitions of the first run are logged to a temporary file. While the
+ * second run goes on, the log is read up to its current time and both streams
+ * are compared second by second, until the first second in which a process
+ * changes state differently. A process finished by both runs is compared at
+ * once and forgotten, so memory grows with the processes finished by only one
+ * of them, not with the workload. The totals and the processes with the
+ * largest turnaround deltas, kept in a heap of MAX_RANKED entries, are the
+ * whole report.
+ */
+class RunDiff : public TransitionObserver {
+public:
+    RunDiff(const std::string& tmp_dir) :
+        log(tmp_dir),
+        comparing(false),
+        last_time(0),
+        diverged(false),
+        divergence_time(0),
+        divergence_pid(0),
+        compared(0),
+        changed(0) {
+        divergence_a = divergence_b = {0, 0, 0, 0, 0, 0, 0};
+        totals_a = totals_b = {0, 0, 0};
+    }
+
+    ~RunDiff() {}
+
+    bool is_open() const {
+        return log.is_open();
+    }
+
+    /**
+     * @return False if the first run could not be fully logged.
+     */
+    bool is_good() const {
+        return log.is_good();
+    }
+
+    /**
+     * @brief Logs a transition of the first run, or compares one of the
+     * second run with the log.
+     */
+    void on_transition(const Process& process,
+                       unsigned long from,
+                       unsigned long to,
+                       unsigned long current_time) override {
+        // Transitions are expected in time order; a late one counts in the
+        // second being compared, in both runs alike.
+        TransitionLog::Record record = {
+            std::max<uint64_t>(current_time, last_time),
+            process.get_pid(), static_cast<uint32_t>(from),
+            static_cast<uint32_t>(to), 0, 0, 0};
+        if (to == DONE) {
+            record.turnaround_time = process.get_turnaround_time();
+            record.waiting_time = process.get_waiting_time();
+            record.context_changes = process.get_context_changes();
+        }
+        if (!comparing) {
+            last_time = record.time;
+            log.write(record);
+            return;
+        }
+        if (record.time > last_time)
+            compare_until(record.time);
+        last_time = record.time;
+        if (!diverged)
+            bucket_b.push_back(record);
+        if (to == DONE)
+            finish(record, false);
+    }
+
+    /**
+     * @brief Ends the first run: the transitions from now on are the ones of
+     * the second run.
+     */
+    void start_second_run() {
+        comparing = true;
+        last_time = 0;
+        log.rewind();
+    }
+
+    /**
+     * @brief Ends the second run and compares what is left of the log.
+     */
+    void end_second_run() {
+        compare_until(UINT64_MAX);
+    }
+
+    /**
+     * @brief Prints the first divergence, the totals of both runs and the
+     * processes whose turnaround time changed the most.
+     */
+    void print_report(const std::string& name_a, const std::string& name_b) {
+        std::cout << "Diff: A = " << name_a << ", B = " << name_b
+                  << std::endl;
+        if (diverged) {
+            std::cout << "First divergence: t=" << divergence_time << ", P"
+                      << divergence_pid << " (A: "
+                      << describe(divergence_a) << ", B: "
+                      << describe(divergence_b) << ")" << std::endl;
+        } else {
+            std::cout << "First divergence: none, the runs are identical"
+                      << std::endl;
+        }
+        std::cout << "Processes compared: " << compared << ", changed: "
+                  << changed << std::endl;
+        if (!live.empty())
+            std::cout << "Processes finished by only one run: "
+                      << live.size() << std::endl;
+        std::cout << std::endl;
+
+        double count = compared ? static_cast<double>(compared) : 1;
+        std::cout << std::left << std::setw(24) << ""
+                  << std::setw(14) << "A" << std::setw(14) << "B"
+                  << "Delta" << std::endl;
+        print_total("Average turnaround time", totals_a.turnaround_time / count,
+                    totals_b.turnaround_time / count, 2);
+        print_total("Average waiting time", totals_a.waiting_time / count,
+                    totals_b.waiting_time / count, 2);
+        print_total("Total context changes", totals_a.context_changes,
+                    totals_b.context_changes, 0);
+
+        std::vector<Delta> ranked;
+        for (; !most_affected.empty(); most_affected.pop())
+            ranked.push_back(most_affected.top());
+        if (ranked.empty()) {
+            std::cout << std::right;
+            return;
+        }
+        std::cout << std::endl << "Most affected processes:" << std::endl
+                  << std::left << std::setw(8) << "PID"
+                  << std::setw(10) << "TT A" << std::setw(10) << "TT B"
+                  << std::setw(10) << "TT delta"
+                  << std::setw(10) << "WT A" << std::setw(10) << "WT B"
+                  << std::setw(10) << "WT delta"
+                  << std::setw(8) << "CC A" << std::setw(8) << "CC B"
+                  << "CC delta" << std::endl;
+        for (auto delta = ranked.rbegin(); delta != ranked.rend(); ++delta) {
+            std::cout << std::setw(8) << "P" + std::to_string(delta->pid)
+                      << std::setw(10) << delta->a.turnaround_time
+                      << std::setw(10) << delta->b.turnaround_time
+                      << std::setw(10) << signed_text(delta->turnaround())
+                      << std::setw(10) << delta->a.waiting_time
+                      << std::setw(10) << delta->b.waiting_time
+                      << std::setw(10) << signed_text(delta->waiting())
+                      << std::setw(8) << delta->a.context_changes
+                      << std::setw(8) << delta->b.context_changes
+                      << signed_text(delta->context_changes()) << std::endl;
+        }
+        std::cout << std::right;
+    }
+
+    static const std::size_t MAX_RANKED = 20;
+
+private:
+    struct Stats {
+        uint64_t turnaround_time;
+        uint64_t waiting_time;
+        uint64_t context_changes;
+    };
+
+    // A process finished by one run, waiting for the other.
+    struct Pending {
+        Stats stats;
+        bool in_a;
+    };
+
+    // A process finished by both runs.
+    struct Delta {
+        uint64_t pid;
+        Stats a;
+        Stats b;
+
+        int64_t turnaround() const {
+            return static_cast<int64_t>(b.turnaround_time - a.turnaround_time);
+        }
+
+        int64_t waiting() const {
+            return static_cast<int64_t>(b.waiting_time - a.waiting_time);
+        }
+
+        int64_t context_changes() const {
+            return static_cast<int64_t>(b.context_changes - a.context_changes);
+        }
+    };
+
+    // Orders the deltas from the most to the least affected process, so the
+    // least affected is on top of the heap.
+    struct MoreAffected {
+        bool operator()(const Delta& lhs, const Delta& rhs) const {
+            uint64_t lhs_turnaround = std::llabs(lhs.turnaround());
+            uint64_t rhs_turnaround = std::llabs(rhs.turnaround());
+            if (lhs_turnaround != rhs_turnaround)
+                return lhs_turnaround > rhs_turnaround;
+            uint64_t lhs_waiting = std::llabs(lhs.waiting());
+            uint64_t rhs_waiting = std::llabs(rhs.waiting());
+            if (lhs_waiting != rhs_waiting)
+                return lhs_waiting > rhs_waiting;
+            return lhs.pid < rhs.pid;
+        }
+    };
+
+    TransitionLog log;
+    bool comparing;
+    uint64_t last_time;             // Of the last transition of the run
+    std::vector<TransitionLog::Record> bucket_a;
+    std::vector<TransitionLog::Record> bucket_b;    // All in one second
+    bool diverged;
+    uint64_t divergence_time;
+    uint64_t divergence_pid;
+    TransitionLog::Record divergence_a;     // pid 0 if A had none
+    TransitionLog::Record divergence_b;
+    std::unordered_map<uint64_t, Pending> live;
+    std::priority_queue<Delta, std::vector<Delta>, MoreAffected> most_affected;
+    unsigned long compared;
+    unsigned long changed;
+    Stats totals_a;
+    Stats totals_b;
+
+    // Compares the seconds before time, in order: the logged transitions of
+    // the first run in each one against the ones of the second run, which
+    // are all in bucket_b.
+    void compare_until(uint64_t time) {
+        while (true) {
+            const TransitionLog::Record* record = log.peek();
+            uint64_t second = record ? record->time : UINT64_MAX;
+            if (!bucket_b.empty())
+                second = std::min(second, bucket_b[0].time);
+            if (second == UINT64_MAX || second >= time)
+                break;
+            for (; (record = log.peek()) && record->time == second;
+                 log.pop()) {
+                if (!diverged)
+                    bucket_a.push_back(*record);
+                if (record->to == DONE)
+                    finish(*record, true);
+            }
+            if (!diverged)
+                compare_second(second);
+        }
+    }
+
+    // Compares the transitions of both runs in a second. The first one that
+    // differs is the one of the lowest pid.
+    void compare_second(uint64_t second) {
+        std::vector<TransitionLog::Record> none;
+        std::vector<TransitionLog::Record>& other =
+            !bucket_b.empty() && bucket_b[0].time == second ? bucket_b : none;
+        std::sort(bucket_a.begin(), bucket_a.end(), before);
+        std::sort(other.begin(), other.end(), before);
+        std::size_t i = 0;
+        while (i < bucket_a.size() && i < other.size() &&
+               !before(bucket_a[i], other[i]) && !before(other[i], bucket_a[i]))
+            i++;
+        bool in_a = i < bucket_a.size();
+        bool in_b = i < other.size();
+        if (in_a || in_b) {
+            diverged = true;
+            divergence_time = second;
+            if (in_a && (!in_b || bucket_a[i].pid <= other[i].pid))
+                divergence_a = bucket_a[i];
+            if (in_b && (!in_a || other[i].pid <= bucket_a[i].pid))
+                divergence_b = other[i];
+            divergence_pid = divergence_a.pid ? divergence_a.pid :
+                                                divergence_b.pid;
+        }
+        bucket_a.clear();
+        other.clear();
+    }
+
+    static bool before(const TransitionLog::Record& lhs,
+                       const TransitionLog::Record& rhs) {
+        if (lhs.pid != rhs.pid)
+            return lhs.pid < rhs.pid;
+        if (lhs.from != rhs.from)
+            return lhs.from < rhs.from;
+        return lhs.to < rhs.to;
+    }
+
+    // Compares a process once both runs finished it.
+    void finish(const TransitionLog::Record& record, bool in_a) {
+        Stats stats = {record.turnaround_time, record.waiting_time,
+                       record.context_changes};
+        auto found = live.find(record.pid);
+        if (found == live.end()) {
+            live[record.pid] = {stats, in_a};
+            return;
+        }
+        Delta delta = {record.pid, found->second.stats, stats};
+        if (in_a)
+            std::swap(delta.a, delta.b);
+        live.erase(found);
+
+        compared++;
+        add(totals_a, delta.a);
+        add(totals_b, delta.b);
+        if (!delta.turnaround() && !delta.waiting() && !delta.context_changes())
+            return;
+        changed++;
+        most_affected.push(delta);
+        if (most_affected.size() > MAX_RANKED)
+            most_affected.pop();
+    }
+
+    static void add(Stats& totals, const Stats& stats) {
+        totals.turnaround_time += stats.turnaround_time;
+        totals.waiting_time += stats.waiting_time;
+        totals.context_changes += stats.context_changes;
+    }
+
+    static std::string describe(const TransitionLog::Record& record) {
+        if (!record.pid)
+            return "no change";
+        return std::string(state_name(record.from)) + " -> " +
+               state_name(record.to);
+    }
+
+    static const char* state_name(unsigned long state) {
+        switch (state)
+        {
+        case NEW:
+            return "NEW";
+        case READY:
+            return "READY";
+        case RUNNING:
+            return "RUNNING";
+        case DONE:
+            return "DONE";
+        case BLOCKED:
+            return "BLOCKED";
+        default:
+            return "?";
+        }
+    }
+
+    static std::string signed_text(int64_t value) {
+        return (value > 0 ? "+" : "") + std::to_string(value);
+    }
+
+    static void print_total(const char* name, double a, double b,
+                            int precision) {
+        std::cout << std::setw(24) << name << std::fixed
+                  << std::setprecision(precision) << std::setw(14) << a
+                  << std::setw(14) << b << (b >= a ? "+" : "") << b - a
+                  << std::defaultfloat << std::setprecision(6) << std::endl;
+    }
+};
+
+#endif // RUN_DIFF_H
@@ -0,0 +1,180 @@
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <dirent.h>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "kernel.h"
+#include "live_metrics.h"
+
+/**
+ * @file schedtop.cpp
+ * @brief Shows the progress of running simulations started with --live, read
+ * from their shared memory segments (see LiveMetrics).
+ */
+
+static bool is_alive(unsigned long pid) {
+    return kill(static_cast<pid_t>(pid), 0) == 0 || errno != ESRCH;
+}
+
+/**
+ * @return The pids of the running simulators that published a segment. The
+ * segments of simulators killed before removing them are removed.
+ */
+static std::vector<unsigned long> find_simulators() {
+    std::vector<unsigned long> pids;
+    std::string prefix = LiveSegment::name(0);
+    prefix = prefix.substr(1, prefix.size() - 2);
+    DIR* dir = opendir("/dev/shm");
+    if (!dir)
+        return pids;
+    while (dirent* entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name.rfind(prefix, 0) != 0)
+            continue;
+        unsigned long pid = std::strtoul(name.c_str() + prefix.size(),
+                                         nullptr, 10);
+        if (is_alive(pid))
+            pids.push_back(pid);
+        else
+            shm_unlink(("/" + name).c_str());
+    }
+    closedir(dir);
+    return pids;
+}
+
+static const LiveSegment* attach(unsigned long pid) {
+    std::string name = LiveSegment::name(pid);
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        return nullptr;
+    void* map = mmap(nullptr, sizeof(LiveSegment), PROT_READ, MAP_SHARED,
+                     fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return nullptr;
+    const LiveSegment* segment = static_cast<const LiveSegment*>(map);
+    if (segment->magic != LiveSegment::MAGIC) {
+        munmap(map, sizeof(LiveSegment));
+        return nullptr;
+    }
+    return segment;
+}
+
+// Per second rate of a counter between two samples.
+static double rate(uint64_t now, uint64_t before, double seconds) {
+    return seconds > 0 && now >= before ? (now - before) / seconds : 0;
+}
+
+static void show(const LiveCounters& now, const LiveCounters& before,
+                 bool alive) {
+    double seconds = now.wall_time >= before.wall_time ?
+                     (now.wall_time - before.wall_time) / 1e9 : 0;
+    double finished = now.finished ? static_cast<double>(now.finished) : 1;
+    double done_rate = rate(now.finished, before.finished, seconds);
+    double total = now.total_processes ?
+                   static_cast<double>(now.total_processes) : 1;
+
+    std::string name = SchedulerFactory().get_name(now.scheduler_type);
+    if (now.scheduler_type >= RR)
+        name += " (quantum " + std::to_string(now.quantum) + ")";
+    std::cout << "schedtop - pid " << now.pid << ", " << name << ", "
+              << (!alive ? "exited" :
+                  now.state == LIVE_DONE ? "run done" : "running")
+              << std::endl << std::endl
+              << std::fixed << std::setprecision(1) << std::left
+              << std::setw(18) << "Simulated time" << now.simulated_time
+              << " (" << rate(now.simulated_time, before.simulated_time,
+                              seconds) << "/s)" << std::endl
+              << std::setw(18) << "Loop iterations" << now.iterations
+              << " (" << rate(now.iterations, before.iterations, seconds)
+              << "/s)" << std::endl
+              << std::setw(18) << "Created" << now.created << " of "
+              << now.total_processes << " ("
+              << 100 * now.created / total << "%)" << std::endl
+              << std::setw(18) << "Done" << now.finished << " ("
+              << 100 * now.finished / total << "%, " << done_rate << "/s)"
+              << std::endl
+              << std::setw(18) << "Ready queue" << now.ready << std::endl
+              << std::setw(18) << "Preemptions" << now.preemptions << " ("
+              << rate(now.preemptions, before.preemptions, seconds) << "/s)"
+              << std::endl
+              << std::setprecision(2)
+              << std::setw(18) << "Avg turnaround" << now.turnaround_time /
+                                                      finished << std::endl
+              << std::setw(18) << "Avg waiting" << now.waiting_time / finished
+              << std::endl << std::setprecision(1)
+              << std::setw(18) << "Elapsed" << now.wall_time / 1e9 << "s";
+    if (now.state == LIVE_RUNNING && done_rate > 0 &&
+        now.total_processes >= now.finished)
+        std::cout << ", about " << (now.total_processes - now.finished) /
+                                   done_rate << "s left";
+    std::cout << std::endl;
+}
+
+int main(int argc, char** argv) {
+
+    unsigned long interval_ms = 1000;
+    bool once = false;
+    unsigned long pid = 0;
+    for (int i = 1; i < argc; i++) {
+        std::string argument(argv[i]);
+        if (argument.rfind("--interval=", 0) == 0) {
+            interval_ms = std::strtoul(argument.c_str() + 11, nullptr, 10);
+        } else if (argument == "--once") {
+            once = true;
+        } else if (argument.rfind("--", 0) == 0) {
+            std::cout << "Unknown option: " << argument << std::endl;
+            return 1;
+        } else {
+            pid = std::strtoul(argument.c_str(), nullptr, 10);
+        }
+    }
+
+    if (!pid) {
+        std::vector<unsigned long> pids = find_simulators();
+        if (pids.size() != 1) {
+            std::cout << "Usage: ./schedtop <pid> (optional if only one "
+                         "simulation runs) [--interval=<ms>] [--once]"
+                      << std::endl;
+            for (unsigned long found : pids)
+                std::cout << "  " << found << std::endl;
+            return 1;
+        }
+        pid = pids[0];
+    }
+
+    const LiveSegment* segment = attach(pid);
+    if (!segment) {
+        std::cout << "Erro: nenhuma simulação com --live no pid " << pid
+                  << std::endl;
+        return 1;
+    }
+
+    // The first rates are the means since the run started.
+    LiveCounters before = {};
+    LiveCounters now;
+    segment->read(now);
+    while (true) {
+        bool alive = is_alive(pid);
+        if (!once)
+            std::cout << "\033[H\033[2J";
+        if (now.scheduler_type != before.scheduler_type ||
+            now.wall_time < before.wall_time)
+            before = {};
+        show(now, before, alive);
+        std::cout.flush();
+        if (once || !alive)
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+        before = now;
+        segment->read(now);
+    }
+    munmap(const_cast<LiveSegment*>(segment), sizeof(LiveSegment));
+    if (!is_alive(pid))
+        shm_unlink(LiveSegment::name(pid).c_str());
+    return 0;
+}
@@ -3,10 +3,22 @@
 #define UNUSED(x) (void)(x)
 
 
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <map>
 #include <queue>
+#include <iomanip>
 #include <iostream>
+#include <unordered_map>
+#include <vector>
+#include "group_queue.h"
+#include "pairing_queue.h"
 #include "process.h"
 #include "process_queue.h"
+#include "snapshot.h"
+#include "transition.h"
 
 /**
  * @class Scheduler
@@ -18,7 +30,15 @@
  */
 class Scheduler {
 public:
-    Scheduler() {
+    // The processes finished so far and the sums of their statistics.
+    struct Totals {
+        unsigned long finished;
+        unsigned long turnaround_time;
+        unsigned long waiting_time;
+    };
+
+    Scheduler() : observer(nullptr), burst_observer(nullptr),
+                  collecting_finished(false), totals({0, 0, 0}) {
         init_process = new Process();
         current_process = init_process;
     }
@@ -30,36 +50,156 @@ public:
      *
      * The scheduler will run the current process for one second.
      * If the process is done, it will be removed from the queue
-     * and the next process will be executed.
+     * and the next process will be executed. A process that is done with a
+     * CPU burst but still has I/O to do is BLOCKED instead (see
+     * take_blocked).
      *
      * @return The pid of the process that was executed.
      */
     unsigned long run(unsigned long current_time) {
+        unsigned long pid = dispatch(current_time);
+        if (pid)
+            execute();
+        return pid;
+    }
+
+    /**
+     * @brief Gives the CPU to the process that runs for the second starting
+     * at current_time, as run does, without running it yet.
+     *
+     * @return The pid of that process, or 0 if the CPU is idle.
+     */
+    unsigned long dispatch(unsigned long current_time) {
         if (process_queue->empty() && current_process->is_done()) {
-            current_process->set_state(DONE, current_time);
+            finish_burst(current_process, current_time);
             current_process = init_process;
             return 0;
         }
         if (current_process->is_done()) {
-            current_process->set_state(DONE, current_time);
+            finish_burst(current_process, current_time);
             current_process = process_queue->front();
             process_queue->pop();
         }
-        current_process->set_state(RUNNING, current_time);
-        current_process->run();
+        change_state(current_process, RUNNING, current_time);
         return current_process->get_pid();
     }
 
+    /**
+     * @brief Runs the dispatched process for one second. A second in which
+     * the CPU switches to it instead is dispatched but not executed.
+     */
+    void execute() {
+        current_process->run();
+    }
+
+    /**
+     * @brief Extends the second just run into a slice of up to max_seconds
+     * more seconds.
+     *
+     * The current process keeps the CPU for as long as nothing could preempt
+     * it: until its burst is done, until its policy could preempt it (see
+     * preemption_horizon) or until max_seconds, which the caller sets to the
+     * time of its next event. Those seconds are added to the process at once.
+     *
+     * @return The number of seconds added.
+     */
+    unsigned long extend(unsigned long current_time, unsigned long max_seconds) {
+        if (current_process == init_process)
+            return 0;
+        unsigned long extra = std::min({
+            max_seconds,
+            current_process->get_duration() -
+            current_process->get_total_execution_time(),
+            preemption_horizon(current_time + 1)});
+        current_process->run(extra);
+        return extra;
+    }
+
+    /**
+     * @brief Moves the processes that blocked for I/O since the last call to
+     * blocked. They come back through feed when their I/O is done.
+     */
+    void take_blocked(std::vector<Process*>& blocked) {
+        blocked.swap(blocked_processes);
+        blocked_processes.clear();
+    }
+
+    /**
+     * @brief Makes the scheduler keep the processes that are done until they
+     * are taken by take_finished. The scheduler holds no pointer to them.
+     */
+    void collect_finished() {
+        collecting_finished = true;
+    }
+
+    /**
+     * @brief Moves the processes that are done since the last call to
+     * finished (see collect_finished).
+     */
+    void take_finished(std::vector<Process*>& finished) {
+        finished.swap(finished_processes);
+        finished_processes.clear();
+    }
+
+    /**
+     * @brief If the current process is done with its CPU burst, asks the
+     * burst observer what it does next. Called right before run, so the
+     * processes a program spawns are fed before the next dispatch.
+     */
+    void end_burst(unsigned long current_time) {
+        if (!burst_observer || current_process == init_process ||
+            !current_process->is_done())
+            return;
+        switch (burst_observer->on_burst_end(*current_process, current_time)) {
+        case BURST_YIELDED:
+            // With nothing else to run, the process keeps the CPU.
+            if (process_queue->empty())
+                break;
+            // The process is pushed while still running, so an aging queue
+            // counts its wait from the time it last became ready.
+            process_queue->push(current_process);
+            if (process_queue->front() == current_process) {
+                process_queue->pop();
+                break;
+            }
+            change_state(current_process, READY, current_time);
+            current_process = process_queue->front();
+            process_queue->pop();
+            break;
+        case BURST_BLOCKED:
+            change_state(current_process, BLOCKED, current_time);
+            blocked_processes.push_back(current_process);
+            current_process = init_process;
+            break;
+        default:
+            break;
+        }
+    }
+
+    /**
+     * @brief Blocks a process that is not on the CPU, such as a program that
+     * waits for I/O before its first CPU burst.
+     */
+    void block(Process* process, unsigned long current_time) {
+        change_state(process, BLOCKED, current_time);
+    }
+
+    /**
+     * @brief Marks a process that is not on the CPU as done.
+     */
+    void retire(Process* process, unsigned long current_time) {
+        change_state(process, DONE, current_time);
+    }
+
     /**
      * @brief Feeds the scheduler with new processes.
      *
      * @param new_processes The new processes to be fed.
      */
     void feed(std::vector<Process*> new_processes, unsigned long current_time) {
-        for (auto process : new_processes) {
-            process->set_state(READY, current_time);
-            process_queue->push(process);
-        }
+        for (auto process : new_processes)
+            change_state(process, READY, current_time);
+        process_queue->push_in_order(new_processes);
     }
 
     /**
@@ -71,6 +211,13 @@ public:
         return current_process->get_pid();
     }
 
+    /**
+     * @return The process on the CPU, or an idle process of pid 0.
+     */
+    Process* get_current_process() {
+        return current_process;
+    }
+
     /**
      * @brief Implements preemption according to the scheduler type.
      * Attributes the current process as the preempting process and inserts
@@ -80,10 +227,198 @@ public:
      */
     virtual bool has_preemption(unsigned long current_time) = 0;
 
+    /**
+     * @return How many more seconds the current process can run from
+     * next_time, the start of the next second, if no process arrives, before
+     * has_preemption could preempt it.
+     */
+    virtual unsigned long preemption_horizon(unsigned long next_time) {
+        UNUSED(next_time);
+        return ULONG_MAX;}
+
+    /**
+     * @brief Prints the metrics kept by the policy itself, after the
+     * statistics of the run, for the policies that keep them.
+     */
+    virtual void print_report() const {}
+
+    /**
+     * @brief Orders the ready processes of the policies that order them by a
+     * key in a pairing heap (see PairingProcessQueue) instead of a binary
+     * heap, so bursts of arrivals are pushed in O(k). Processes with equal
+     * keys then leave the queue in the order they entered it. Called before
+     * any process is fed.
+     */
+    virtual void set_pairing_heap() {}
+
+    /**
+     * @return True if the policy may take the CPU from a process before it is
+     * done. Otherwise, every dispatched process runs to completion.
+     */
+    virtual bool is_preemptive() {
+        return true;}
+
+    const Totals& get_totals() const {
+        return totals;
+    }
+
+    /**
+     * @return The number of processes in the ready queue.
+     */
+    std::size_t ready_size() {
+        return process_queue->size();
+    }
+
+    /**
+     * @brief Sets the observer notified of every state change of the
+     * scheduled processes. The observer is not owned by the scheduler.
+     */
+    void set_observer(TransitionObserver* observer_) {
+        observer = observer_;
+    }
+
+    /**
+     * @brief Sets the observer asked what a process does at the end of each
+     * CPU burst. The observer is not owned by the scheduler.
+     */
+    void set_burst_observer(BurstObserver* burst_observer_) {
+        burst_observer = burst_observer_;
+    }
+
+    /**
+     * @brief Appends the process on the CPU, if any, and the ready processes
+     * to processes.
+     */
+    void copy_scheduled(std::vector<Process*>& processes) {
+        if (current_process != init_process)
+            processes.push_back(current_process);
+        process_queue->copy_to(processes);
+    }
+
+    /**
+     * @brief Writes the totals, the running process, the ready queue in the
+     * order it is stored and the state of the policy to a snapshot. Called
+     * between two seconds, when no process is waiting to be taken as blocked.
+     */
+    void save(SnapshotFile& snapshot) {
+        save_policy(snapshot);
+        snapshot.put(totals.finished);
+        snapshot.put(totals.turnaround_time);
+        snapshot.put(totals.waiting_time);
+        snapshot.put(current_process->get_pid());
+        std::vector<Process*> ready;
+        process_queue->copy_to(ready);
+        snapshot.put(ready.size());
+        for (Process* process : ready)
+            snapshot.put(process->get_pid());
+    }
+
+    /**
+     * @brief Restores the state written by save. processes maps the pid of
+     * each process that is not done to the process.
+     *
+     * @return False if the snapshot is bad or names an unknown pid.
+     */
+    bool restore(SnapshotFile& snapshot,
+                 const std::unordered_map<unsigned long, Process*>& processes) {
+        if (!restore_policy(snapshot))
+            return false;
+        totals.finished = snapshot.get();
+        totals.turnaround_time = snapshot.get();
+        totals.waiting_time = snapshot.get();
+        uint64_t pid = snapshot.get();
+        auto process = processes.find(pid);
+        if (pid && process == processes.end())
+            return false;
+        current_process = pid ? process->second : init_process;
+        uint64_t count = snapshot.get();
+        if (count > processes.size())
+            return false;
+        std::vector<Process*> ready;
+        for (uint64_t i = 0; i < count; i++) {
+            process = processes.find(snapshot.get());
+            if (process == processes.end())
+                return false;
+            ready.push_back(process->second);
+        }
+        process_queue->assign(ready);
+        return snapshot.good();
+    }
+
 protected:
     Process* init_process;
     Process* current_process;
     ProcessQueueWrapper *process_queue;
+    TransitionObserver* observer;
+    BurstObserver* burst_observer;
+    std::vector<Process*> blocked_processes;
+    bool collecting_finished;
+    std::vector<Process*> finished_processes;
+    Totals totals;
+
+
+    // Takes a process that is done with its CPU burst off the CPU.
+    void finish_burst(Process* process, unsigned long current_time) {
+        if (process->has_io()) {
+            change_state(process, BLOCKED, current_time);
+            blocked_processes.push_back(process);
+        } else {
+            change_state(process, DONE, current_time);
+        }
+    }
+
+    /**
+     * @brief Sets the state of a process and notifies the observer if the
+     * state actually changed.
+     */
+    void change_state(Process* process, unsigned long state,
+                      unsigned long current_time) {
+        unsigned long previous = process->get_state_id();
+        process->set_state(state, current_time);
+        if (previous == state || !process->get_pid())
+            return;
+        if (state == DONE) {
+            totals.finished++;
+            totals.turnaround_time += process->get_turnaround_time();
+            totals.waiting_time += process->get_waiting_time();
+            if (collecting_finished)
+                finished_processes.push_back(process);
+        }
+        on_state_change(*process, previous, state, current_time);
+        if (observer)
+            observer->on_transition(*process, previous, state, current_time);
+    }
+
+    /**
+     * @brief Called on every state change of a scheduled process, for the
+     * policies that keep metrics of their own.
+     */
+    virtual void on_state_change(const Process& process,
+                                 unsigned long from,
+                                 unsigned long to,
+                                 unsigned long current_time) {
+        UNUSED(process);
+        UNUSED(from);
+        UNUSED(to);
+        UNUSED(current_time);
+    }
+
+    /**
+     * @brief Writes the state of the policy itself, for the policies that
+     * keep one, before the queue (see save).
+     */
+    virtual void save_policy(SnapshotFile& snapshot) {
+        UNUSED(snapshot);
+    }
+
+    /**
+     * @brief Reads the state written by save_policy. Policies that change the
+     * kind of their queue create it here, before it is refilled.
+     */
+    virtual bool restore_policy(SnapshotFile& snapshot) {
+        UNUSED(snapshot);
+        return true;
+    }
 
 };
 
@@ -110,6 +445,9 @@ public:
         UNUSED(current_time);
         return false;}
 
+    bool is_preemptive() {
+        return false;}
+
 };
 
 /**
@@ -138,10 +476,18 @@ public:
         delete init_process;
     }
 
+    void set_pairing_heap() {
+        delete process_queue;
+        process_queue = new PairingProcessQueue<CompareProcess>(c);
+    }
+
     bool has_preemption(unsigned long current_time) {
         UNUSED(current_time);
         return false; }
 
+    bool is_preemptive() {
+        return false;}
+
 };
 
 // Specialization PNPScheduler
@@ -152,6 +498,9 @@ public:
  * The jobs are ordered by priority and processed by this
  * order
  *
+ * With aging (see set_aging), a process gains one priority level for every
+ * period seconds it waits in the ready queue, so a stream of processes of
+ * higher priority can delay it but not starve it.
  */
 class PNPScheduler : public Scheduler {
 private:
@@ -163,7 +512,15 @@ private:
     CompareProcess c;
 
 public:
-    PNPScheduler() : Scheduler() {
+    // The waits in the ready queue of the processes of a priority.
+    struct PriorityWaits {
+        unsigned long dispatches;
+        unsigned long total_wait;
+        unsigned long max_wait;     // Longest single wait
+    };
+
+    PNPScheduler() : Scheduler(), aging(nullptr), aging_period(0),
+                     keep_waits(false) {
         process_queue = new PriorityProcessQueue<CompareProcess>(c);}
 
     ~PNPScheduler() {
@@ -171,34 +528,158 @@ public:
         delete init_process;
     }
 
+    void set_pairing_heap() {
+        delete process_queue;
+        process_queue = new PairingProcessQueue<CompareProcess>(c);
+    }
+
     bool has_preemption(unsigned long current_time) {
         UNUSED(current_time);
         return false; }
 
+    bool is_preemptive() {
+        return false;}
+
+    /**
+     * @brief Ages the waiting processes by one priority level every period
+     * seconds, or keeps the static priorities if period is 0. Either way, the
+     * waits of each priority are kept for print_report. Called before any
+     * process is fed.
+     */
+    void set_aging(unsigned long period) {
+        keep_waits = true;
+        if (!period)
+            return;
+        delete process_queue;
+        aging = new AgingProcessQueue(period);
+        process_queue = aging;
+        aging_period = period;
+    }
+
+    /**
+     * @brief Prints, for each priority, the number of dispatches and the mean
+     * and longest wait in the ready queue before them.
+     */
+    void print_report() const {
+        if (!keep_waits)
+            return;
+        std::cout << "Aging: ";
+        if (aging)
+            std::cout << "one level every " << aging_period << "s";
+        else
+            std::cout << "off";
+        std::cout << std::endl
+                  << std::setw(10) << "Priority"
+                  << std::setw(12) << "Dispatches"
+                  << std::setw(12) << "Avg wait"
+                  << std::setw(12) << "Max wait" << std::endl;
+        unsigned long printed = 0;
+        for (const auto& priority : waits) {
+            if (printed++ == MAX_PRINTED) {
+                std::cout << "(" << waits.size() - MAX_PRINTED
+                          << " more priorities)" << std::endl;
+                break;
+            }
+            const PriorityWaits& stats = priority.second;
+            std::cout << std::setw(10) << priority.first
+                      << std::setw(12) << stats.dispatches
+                      << std::setw(12) << std::fixed << std::setprecision(2)
+                      << static_cast<double>(stats.total_wait) /
+                         stats.dispatches
+                      << std::setw(12) << stats.max_wait << std::endl;
+        }
+        std::cout.unsetf(std::ios::floatfield);
+        std::cout << std::setprecision(6);
+    }
+
+protected:
+    AgingProcessQueue* aging;       // nullptr without aging
+    unsigned long aging_period;
+    bool keep_waits;
+    std::map<unsigned long, PriorityWaits> waits;
+
+    static const unsigned long MAX_PRINTED = 40;
+
+    void on_state_change(const Process& process,
+                         unsigned long from,
+                         unsigned long to,
+                         unsigned long current_time) override {
+        if (!keep_waits || from != READY || to != RUNNING)
+            return;
+        unsigned long wait = current_time - process.get_last_interrupt();
+        PriorityWaits& stats = waits[process.get_priority()];
+        stats.dispatches++;
+        stats.total_wait += wait;
+        stats.max_wait = std::max(stats.max_wait, wait);
+    }
+
+    void save_policy(SnapshotFile& snapshot) override {
+        snapshot.put(waits.size());
+        for (const auto& priority : waits) {
+            snapshot.put(priority.first);
+            snapshot.put(priority.second.dispatches);
+            snapshot.put(priority.second.total_wait);
+            snapshot.put(priority.second.max_wait);
+        }
+    }
+
+    // The aging queue was created by set_aging and its keys are recomputed
+    // from the processes when it is refilled.
+    bool restore_policy(SnapshotFile& snapshot) override {
+        waits.clear();
+        uint64_t count = snapshot.get();
+        for (uint64_t i = 0; i < count && snapshot.good(); i++) {
+            PriorityWaits& stats = waits[snapshot.get()];
+            stats.dispatches = snapshot.get();
+            stats.total_wait = snapshot.get();
+            stats.max_wait = snapshot.get();
+        }
+        return snapshot.good();
+    }
+
 };
 
 /**
  * @class PPScheduler
  * @brief Specialyze the Priority, with preemption Scheduler.
  *
- * The 
+ * The running process is preempted as soon as a waiting process has a higher
+ * priority. With aging, that happens when a waiting process has aged past the
+ * priority of the running one, at a time preemption_horizon computes, so the
+ * kernel arms a timer for it.
  *
  */
 class PPScheduler : public PNPScheduler {
 public:
+    bool is_preemptive() {
+        return true;}
+
     bool has_preemption(unsigned long current_time) {
-        if (!current_process->is_done() && !process_queue->empty()) {
-            if (current_process->get_priority() <
-                process_queue->front()->get_priority()
-                ) {
-                process_queue->push(current_process);
-                current_process->set_state(READY, current_time);
-                current_process = process_queue->front();
-                process_queue->pop();
-                return true;
-            }
-        }
-        return false;
+        if (current_process->is_done() || process_queue->empty())
+            return false;
+        bool preempt = aging ?
+                       aging->front_key() + static_cast<int64_t>(current_time) >
+                       aging->effective_key(current_process) :
+                       current_process->get_priority() <
+                       process_queue->front()->get_priority();
+        if (!preempt)
+            return false;
+        // Ready first, so that an aging queue counts its wait from now.
+        change_state(current_process, READY, current_time);
+        process_queue->push(current_process);
+        current_process = process_queue->front();
+        process_queue->pop();
+        return true;
+    }
+
+    unsigned long preemption_horizon(unsigned long next_time) {
+        if (!aging || process_queue->empty())
+            return ULONG_MAX;
+        // The first second at which the front outranks the running process.
+        int64_t preemption = aging->effective_key(current_process) -
+                             aging->front_key() + 1;
+        int64_t next = static_cast<int64_t>(next_time);
+        return preemption > next ? preemption - next : 0;
     }
 };
 
@@ -229,7 +710,7 @@ public:
         if (!current_process->is_done() && !process_queue->empty()) {
             if (current_process->get_total_execution_time() % quantum == 0) {
                 process_queue->push(current_process);
-                current_process->set_state(READY, current_time);
+                change_state(current_process, READY, current_time);
                 current_process = process_queue->front();
                 process_queue->pop();
                 return true;
@@ -238,6 +719,552 @@ public:
         return false;
     }
 
+    unsigned long preemption_horizon(unsigned long next_time) {
+        UNUSED(next_time);
+        if (process_queue->empty())
+            return ULONG_MAX;
+        return (quantum - current_process->get_total_execution_time() % quantum)
+               % quantum;
+    }
+
+};
+
+/**
+ * @class AdaptiveScheduler
+ * @brief Switches between the FCFS, SJF, PP and RR disciplines at run time,
+ * according to the metrics of the last window of simulated seconds.
+ *
+ * The scheduler keeps, from the state changes of its processes, the area
+ * under the depth of the ready queue, the arrivals to it and the dispatches
+ * from it. At the end of each window (see review) it computes the mean queue
+ * depth, the arrival rate and the mean waiting time, estimated with Little's
+ * law as the area over the number of dispatches, and looks at the remaining
+ * bursts and priorities of the ready processes to choose the discipline of
+ * the next window:
+ * - RR if the ready processes waited longer than their bursts behind a running
+ *   process much longer than them (a convoy), so it is preempted;
+ * - SJF if the remaining bursts are heterogeneous, which cuts the mean
+ *   waiting time the most;
+ * - PP if the bursts are similar and the load is light, so following the
+ *   priorities costs little waiting;
+ * - FCFS otherwise, as the order of similar bursts hardly matters and it
+ *   switches the least. SJF is kept if it is already in use.
+ * With at most one ready process there is nothing to order, so the
+ * discipline is kept.
+ *
+ * Switching moves the ready processes to a queue of the new discipline at
+ * once: a FIFO queue takes them in the order they leave the old queue and a
+ * heap is built with a single heapify, so a switch is O(n) in the number of
+ * ready processes.
+ */
+class AdaptiveScheduler : public Scheduler {
+public:
+    enum Discipline {
+        DISCIPLINE_FCFS,
+        DISCIPLINE_SJF,
+        DISCIPLINE_PP,
+        DISCIPLINE_RR,
+        DISCIPLINES
+    };
+
+    // The metrics of a window and the discipline chosen at its end.
+    struct Decision {
+        unsigned long time;
+        double depth;           // Mean ready queue depth
+        double arrival_rate;    // Arrivals to the ready queue per second
+        double waiting_time;    // Mean waiting time of the dispatches
+        unsigned long ready;    // Ready processes at the end of the window
+        unsigned long from;     // Discipline
+        unsigned long to;       // Discipline
+    };
+
+    AdaptiveScheduler(unsigned long q) :
+        Scheduler(),
+        quantum(q),
+        window(DEFAULT_WINDOW),
+        discipline(DISCIPLINE_FCFS),
+        window_start(0),
+        area_time(0),
+        area(0),
+        arrivals(0),
+        dispatches(0),
+        ready_count(0),
+        remaining_sum(0),
+        remaining_squares(0),
+        priority_sum(0),
+        priority_squares(0),
+        swaps(0),
+        pairing(false),
+        log(nullptr) {
+        process_queue = create_queue(discipline);
+        for (unsigned long i = 0; i < DISCIPLINES; i++)
+            windows[i] = 0;
+    }
+
+    ~AdaptiveScheduler() {
+        delete init_process;
+        delete process_queue;
+    }
+
+    // The first discipline, FCFS, has no key, so only later queues change.
+    void set_pairing_heap() {
+        pairing = true;
+    }
+
+    bool has_preemption(unsigned long current_time) {
+        if (current_time >= window_start + window)
+            review(current_time);
+        if (current_process->is_done() || process_queue->empty())
+            return false;
+        bool preempt = false;
+        if (discipline == DISCIPLINE_PP)
+            preempt = current_process->get_priority() <
+                      process_queue->front()->get_priority();
+        else if (discipline == DISCIPLINE_RR)
+            preempt = current_process->get_total_execution_time() % quantum == 0;
+        if (!preempt)
+            return false;
+        process_queue->push(current_process);
+        change_state(current_process, READY, current_time);
+        current_process = process_queue->front();
+        process_queue->pop();
+        return true;
+    }
+
+    unsigned long preemption_horizon(unsigned long next_time) {
+        UNUSED(next_time);
+        if (discipline != DISCIPLINE_RR || process_queue->empty())
+            return ULONG_MAX;
+        return (quantum - current_process->get_total_execution_time() % quantum)
+               % quantum;
+    }
+
+    /**
+     * @brief Sets the length of the windows, in seconds. has_preemption
+     * reviews the discipline at the first call after the end of a window, so
+     * the caller must make sure it is called then.
+     */
+    void set_window(unsigned long window_) {
+        window = window_ ? window_ : 1;
+    }
+
+    unsigned long get_window() const {
+        return window;
+    }
+
+    /**
+     * @brief Writes the metrics and the decision of every window to log as
+     * CSV. The stream is not owned by the scheduler.
+     */
+    void set_log(std::ostream* log_) {
+        log = log_;
+        if (log)
+            *log << "time,depth,arrival_rate,waiting_time,ready,discipline"
+                 << std::endl;
+    }
+
+    /**
+     * @brief Prints the switches made and the number of windows run with each
+     * discipline.
+     */
+    void print_report() const {
+        unsigned long total = 0;
+        for (unsigned long i = 0; i < DISCIPLINES; i++)
+            total += windows[i];
+        std::cout << "Adaptive: " << swaps << " switches in " << total
+                  << " windows of " << window << "s (";
+        for (unsigned long i = 0; i < DISCIPLINES; i++)
+            std::cout << (i ? ", " : "") << discipline_name(i) << " "
+                      << windows[i];
+        std::cout << ")" << std::endl;
+        for (std::size_t i = 0; i < switches.size() && i < MAX_PRINTED; i++) {
+            const Decision& decision = switches[i];
+            std::cout << "  t=" << decision.time
+                      << " " << discipline_name(decision.from)
+                      << " -> " << discipline_name(decision.to)
+                      << " (depth " << decision.depth
+                      << ", arrivals/s " << decision.arrival_rate
+                      << ", wait " << decision.waiting_time
+                      << ", ready " << decision.ready << ")" << std::endl;
+        }
+        if (switches.size() > MAX_PRINTED)
+            std::cout << "  ... " << switches.size() - MAX_PRINTED
+                      << " more switches" << std::endl;
+    }
+
+    static const char* discipline_name(unsigned long discipline_) {
+        static const char* names[] = {"FCFS", "SJF", "PP", "RR"};
+        return discipline_ < DISCIPLINES ? names[discipline_] : "?";
+    }
+
+    static const unsigned long DEFAULT_WINDOW = 2;
+
+protected:
+    void on_state_change(const Process& process,
+                         unsigned long from,
+                         unsigned long to,
+                         unsigned long current_time) override {
+        if (to != READY && from != READY)
+            return;
+        accumulate(current_time);
+        double remaining = static_cast<double>(
+            process.get_duration() - process.get_total_execution_time());
+        double priority = static_cast<double>(process.get_priority());
+        if (to == READY) {
+            if (from != RUNNING)
+                arrivals++;
+            ready_count++;
+            remaining_sum += remaining;
+            remaining_squares += remaining * remaining;
+            priority_sum += priority;
+            priority_squares += priority * priority;
+        } else {
+            if (to == RUNNING)
+                dispatches++;
+            ready_count--;
+            remaining_sum -= remaining;
+            remaining_squares -= remaining * remaining;
+            priority_sum -= priority;
+            priority_squares -= priority * priority;
+            // Starts over from exact sums whenever the queue is empty.
+            if (!ready_count)
+                remaining_sum = remaining_squares =
+                    priority_sum = priority_squares = 0;
+        }
+    }
+
+    void save_policy(SnapshotFile& snapshot) override {
+        snapshot.put(discipline);
+        snapshot.put(window_start);
+        snapshot.put(area_time);
+        snapshot.put_double(area);
+        snapshot.put(arrivals);
+        snapshot.put(dispatches);
+        snapshot.put(ready_count);
+        snapshot.put_double(remaining_sum);
+        snapshot.put_double(remaining_squares);
+        snapshot.put_double(priority_sum);
+        snapshot.put_double(priority_squares);
+        snapshot.put(swaps);
+        for (unsigned long i = 0; i < DISCIPLINES; i++)
+            snapshot.put(windows[i]);
+        snapshot.put(switches.size());
+        for (const Decision& decision : switches) {
+            snapshot.put(decision.time);
+            snapshot.put_double(decision.depth);
+            snapshot.put_double(decision.arrival_rate);
+            snapshot.put_double(decision.waiting_time);
+            snapshot.put(decision.ready);
+            snapshot.put(decision.from);
+            snapshot.put(decision.to);
+        }
+    }
+
+    bool restore_policy(SnapshotFile& snapshot) override {
+        unsigned long discipline_ = snapshot.get();
+        if (discipline_ >= DISCIPLINES)
+            return false;
+        window_start = snapshot.get();
+        area_time = snapshot.get();
+        area = snapshot.get_double();
+        arrivals = snapshot.get();
+        dispatches = snapshot.get();
+        ready_count = snapshot.get();
+        remaining_sum = snapshot.get_double();
+        remaining_squares = snapshot.get_double();
+        priority_sum = snapshot.get_double();
+        priority_squares = snapshot.get_double();
+        swaps = snapshot.get();
+        for (unsigned long i = 0; i < DISCIPLINES; i++)
+            windows[i] = snapshot.get();
+        uint64_t count = snapshot.get();
+        switches.clear();
+        for (uint64_t i = 0; i < count && snapshot.good(); i++) {
+            Decision decision;
+            decision.time = snapshot.get();
+            decision.depth = snapshot.get_double();
+            decision.arrival_rate = snapshot.get_double();
+            decision.waiting_time = snapshot.get_double();
+            decision.ready = snapshot.get();
+            decision.from = snapshot.get();
+            decision.to = snapshot.get();
+            switches.push_back(decision);
+        }
+        delete process_queue;
+        process_queue = create_queue(discipline_);
+        discipline = discipline_;
+        return snapshot.good();
+    }
+
+private:
+    // Thresholds of the decision rule (see the class description).
+    static constexpr double CONTENTION_DEPTH = 1.0;
+    static constexpr double HETEROGENEOUS_CV = 0.5;
+    static constexpr double CONVOY_FACTOR = 2.0;
+    static const std::size_t MAX_PRINTED = 20;
+
+    struct ShortestFirst {
+        bool operator()(Process* const& p1, Process* const& p2) {
+            return p1->get_duration() > p2->get_duration();
+        }
+    };
+
+    struct HighestPriority {
+        bool operator()(Process* const& p1, Process* const& p2) {
+            return p1->get_priority() < p2->get_priority();
+        }
+    };
+
+    unsigned long quantum;
+    unsigned long window;
+    unsigned long discipline;
+    unsigned long window_start;
+    unsigned long area_time;
+    double area;                // Ready process-seconds since window_start
+    unsigned long arrivals;
+    unsigned long dispatches;
+    unsigned long ready_count;
+    double remaining_sum;
+    double remaining_squares;
+    double priority_sum;
+    double priority_squares;
+    unsigned long swaps;
+    unsigned long windows[DISCIPLINES];
+    std::vector<Decision> switches;
+    std::vector<Process*> migrating;
+    bool pairing;               // Keyed queues are pairing heaps
+    std::ostream* log;
+
+    ProcessQueueWrapper* create_queue(unsigned long discipline_) const {
+        switch (discipline_) {
+        case DISCIPLINE_SJF:
+            if (pairing)
+                return new PairingProcessQueue<ShortestFirst>(ShortestFirst());
+            return new PriorityProcessQueue<ShortestFirst>(ShortestFirst());
+        case DISCIPLINE_PP:
+            if (pairing)
+                return new PairingProcessQueue<HighestPriority>(
+                    HighestPriority());
+            return new PriorityProcessQueue<HighestPriority>(HighestPriority());
+        default:
+            return new ProcessQueue();
+        }
+    }
+
+    // Adds the ready process-seconds up to current_time to the area.
+    void accumulate(unsigned long current_time) {
+        area += static_cast<double>(ready_count) * (current_time - area_time);
+        area_time = current_time;
+    }
+
+    static double variance(double sum, double squares, unsigned long count) {
+        double mean = sum / count;
+        return std::max(0.0, squares / count - mean * mean);
+    }
+
+    // Closes the window that ends at current_time and switches to the
+    // discipline chosen for the next one.
+    void review(unsigned long current_time) {
+        accumulate(current_time);
+        double span = static_cast<double>(current_time - window_start);
+        Decision decision;
+        decision.time = current_time;
+        decision.depth = area / span;
+        decision.arrival_rate = arrivals / span;
+        decision.waiting_time = area / (dispatches ? dispatches : 1);
+        decision.ready = ready_count;
+        decision.from = discipline;
+        decision.to = choose(decision);
+        windows[discipline]++;
+
+        if (log)
+            *log << decision.time << "," << decision.depth << ","
+                 << decision.arrival_rate << "," << decision.waiting_time
+                 << "," << decision.ready << ","
+                 << discipline_name(decision.to) << "\n";
+        if (decision.to != discipline) {
+            switch_to(decision.to);
+            switches.push_back(decision);
+            swaps++;
+        }
+
+        window_start = current_time;
+        area = 0;
+        arrivals = 0;
+        dispatches = 0;
+    }
+
+    unsigned long choose(const Decision& decision) const {
+        // With at most one ready process there is nothing to order.
+        if (ready_count < 2)
+            return discipline;
+        double mean = remaining_sum / ready_count;
+        double running = static_cast<double>(
+            current_process->get_duration() -
+            current_process->get_total_execution_time());
+        if (decision.waiting_time > mean && running > CONVOY_FACTOR * mean)
+            return DISCIPLINE_RR;
+        double deviation = std::sqrt(
+            variance(remaining_sum, remaining_squares, ready_count));
+        if (mean > 0 && deviation / mean > HETEROGENEOUS_CV)
+            return DISCIPLINE_SJF;
+        bool light_load = decision.depth < CONTENTION_DEPTH &&
+                          decision.arrival_rate * mean < 1;
+        if (light_load &&
+            variance(priority_sum, priority_squares, ready_count) > 0)
+            return DISCIPLINE_PP;
+        if (discipline == DISCIPLINE_SJF)
+            return DISCIPLINE_SJF;
+        return DISCIPLINE_FCFS;
+    }
+
+    // Moves the ready processes to a queue of the new discipline. The
+    // running process keeps the CPU until the new discipline preempts it.
+    void switch_to(unsigned long discipline_) {
+        migrating.clear();
+        process_queue->take_all(migrating);
+        delete process_queue;
+        process_queue = create_queue(discipline_);
+        process_queue->push_range(migrating);
+        discipline = discipline_;
+    }
+};
+
+/**
+ * @class FairShareScheduler
+ * @brief Hierarchical fair-share scheduler: processes belong to a tree of
+ * weighted groups and the CPU is shared between sibling groups in proportion
+ * to their weights (see GroupQueue).
+ *
+ * The running process gets slices of quantum seconds, as in Round Robin. At
+ * the end of a slice its CPU time is charged to it and to its groups, and it
+ * goes back to the queue; it keeps the CPU if it is still the front.
+ * Arrivals do not preempt it.
+ */
+class FairShareScheduler : public Scheduler {
+public:
+    FairShareScheduler(unsigned long q) :
+        Scheduler(),
+        quantum(q),
+        running_since(0) {
+        groups = new GroupQueue();
+        process_queue = groups;
+    }
+
+    ~FairShareScheduler() {
+        delete init_process;
+        delete process_queue;
+    }
+
+    /**
+     * @brief Puts a new process in a group, given by its path (see
+     * ProcessParams::get_group).
+     */
+    void set_group(Process* process, const std::string& path) {
+        groups->set_group(process, path);
+    }
+
+    bool has_preemption(unsigned long current_time) {
+        if (current_process->is_done() || process_queue->empty() ||
+            current_process->get_total_execution_time() % quantum != 0)
+            return false;
+        charge(*current_process, current_time);
+        process_queue->push(current_process);
+        Process* next = process_queue->front();
+        process_queue->pop();
+        if (next == current_process)
+            return false;
+        change_state(current_process, READY, current_time);
+        current_process = next;
+        return true;
+    }
+
+    unsigned long preemption_horizon(unsigned long next_time) {
+        UNUSED(next_time);
+        if (process_queue->empty())
+            return ULONG_MAX;
+        return (quantum - current_process->get_total_execution_time() % quantum)
+               % quantum;
+    }
+
+    /**
+     * @brief Prints the groups, depth first: their weight, processes, CPU
+     * time, share of the CPU time of their parent against the share their
+     * weight entitles them to, and the waiting and turnaround times of their
+     * finished processes.
+     */
+    void print_report() const {
+        std::cout << "Fair share: " << groups->group_count() << " groups"
+                  << std::endl
+                  << "  " << std::setw(24) << std::left << "Group"
+                  << std::right
+                  << std::setw(7) << "Weight" << std::setw(9) << "Procs"
+                  << std::setw(12) << "CPU" << std::setw(8) << "Share"
+                  << std::setw(8) << "Target" << std::setw(12) << "Avg WT"
+                  << std::setw(10) << "Max WT" << std::setw(12) << "Avg TT"
+                  << std::endl;
+        std::size_t printed = 0;
+        print_group(groups->get_root(), nullptr, printed);
+        if (printed > MAX_PRINTED)
+            std::cout << "  ... " << printed - MAX_PRINTED << " more groups"
+                      << std::endl;
+    }
+
+protected:
+    void on_state_change(const Process& process,
+                         unsigned long from,
+                         unsigned long to,
+                         unsigned long current_time) override {
+        if (from == RUNNING)
+            charge(process, current_time);
+        if (to == RUNNING)
+            running_since = current_time;
+        if (to == DONE)
+            groups->finish(process, current_time);
+    }
+
+private:
+    static const std::size_t MAX_PRINTED = 40;
+
+    unsigned long quantum;
+    unsigned long running_since;    // Start of the uncharged CPU time
+    GroupQueue* groups;
+
+    // Charges the running process for its CPU time up to current_time.
+    void charge(const Process& process, unsigned long current_time) {
+        groups->charge(process, current_time - running_since);
+        running_since = current_time;
+    }
+
+    static void print_group(const GroupQueue::Group* group,
+                            const GroupQueue::Group* parent,
+                            std::size_t& printed) {
+        if (printed++ < MAX_PRINTED) {
+            const GroupQueue::GroupStats& stats = group->stats;
+            double share = !parent ? 100.0 : parent->stats.cpu_time ?
+                           100.0 * stats.cpu_time / parent->stats.cpu_time : 0;
+            double target = !parent ? 100.0 : 100.0 * group->entity.weight /
+                            parent->children_weight;
+            unsigned long finished = stats.finished ? stats.finished : 1;
+            std::cout << "  " << std::setw(24) << std::left
+                      << std::string(2 * group->depth, ' ') + group->path
+                      << std::right << std::fixed << std::setprecision(1)
+                      << std::setw(7) << group->entity.weight
+                      << std::setw(9) << stats.processes
+                      << std::setw(12) << stats.cpu_time
+                      << std::setw(7) << share << "%"
+                      << std::setw(7) << target << "%"
+                      << std::setw(12)
+                      << static_cast<double>(stats.waiting_time) / finished
+                      << std::setw(10) << stats.max_waiting_time
+                      << std::setw(12)
+                      << static_cast<double>(stats.turnaround_time) / finished
+                      << std::defaultfloat << std::setprecision(6)
+                      << std::endl;
+        }
+        for (const GroupQueue::Group* child : group->children)
+            print_group(child, group, printed);
+    }
 };
 
 #endif // SCHEDULER_H
\ No newline at end of file
@@ -0,0 +1,109 @@
+#include <climits>
+#include "simulation.h"
+#include "kernel.h"
+
+static_assert(+PROCESS_NEW == +NEW && +PROCESS_READY == +READY &&
+              +PROCESS_RUNNING == +RUNNING && +PROCESS_DONE == +DONE &&
+              +PROCESS_BLOCKED == +BLOCKED,
+              "ProcessState must match States");
+static_assert(AdaptiveScheduler::DEFAULT_WINDOW == 2 &&
+              SwitchCost::DEFAULT_HALF_LIFE == 10,
+              "The defaults of SimulationConfig must match Options");
+
+/**
+ * @class ObserverAdapter
+ * @brief Gives the state changes of the kernel to the observer of the
+ * library, by pid.
+ */
+class ObserverAdapter : public TransitionObserver {
+public:
+    ObserverAdapter(SimulationObserver* observer_) : observer(observer_) {}
+
+    ~ObserverAdapter() {}
+
+    void on_transition(const Process& process,
+                       unsigned long from,
+                       unsigned long to,
+                       unsigned long current_time) override {
+        observer->on_transition(process.get_pid(), from, to, current_time);
+    }
+
+private:
+    SimulationObserver* observer;
+};
+
+// Returns why config cannot be simulated, as Options::parse would reject it,
+// or an empty string.
+static std::string check_config(const SimulationConfig& config) {
+    if (config.scheduler_type < FCFS || config.scheduler_type > FAIR_SHARE)
+        return "Erro: tipo de escalonador inválido";
+    if (!config.program.empty() && !ProgramLibrary::exists(config.program))
+        return "Erro: programa desconhecido: " + config.program;
+    if (!config.adaptive_window)
+        return "Erro: a janela do escalonador adaptativo precisa ser maior "
+               "que zero";
+    if (config.switch_cost < 0 || config.cache_refill < 0 ||
+        !(config.cache_half_life > 0))
+        return "Erro: custo de troca de contexto inválido";
+    return "";
+}
+
+// The workload is read as ints, as from a file.
+static bool fits_params(const ProcessSpec& process) {
+    if (process.creation_time > INT_MAX || process.duration > INT_MAX ||
+        process.priority > INT_MAX)
+        return false;
+    for (unsigned long burst : process.bursts)
+        if (burst > INT_MAX)
+            return false;
+    return true;
+}
+
+SimulationResult simulate_workload(std::span<const ProcessSpec> workload,
+                                   const SimulationConfig& config) {
+    SimulationResult result;
+    result.error = check_config(config);
+    if (!result.error.empty())
+        return result;
+
+    std::vector<ProcessParams> params;
+    params.reserve(workload.size());
+    for (const ProcessSpec& process : workload) {
+        if (!fits_params(process)) {
+            result.error = "Erro: os tempos e a prioridade dos processos "
+                           "precisam caber em um int";
+            return result;
+        }
+        params.emplace_back(static_cast<int>(process.creation_time),
+                            static_cast<int>(process.duration),
+                            static_cast<int>(process.priority));
+        params.back().set_bursts(process.bursts);
+        params.back().set_group(process.group);
+    }
+    std::vector<const ProcessParams*> pointers;
+    pointers.reserve(params.size());
+    for (const ProcessParams& process : params)
+        pointers.push_back(&process);
+    VectorArrivalSource arrivals(std::move(pointers));
+
+    // The options that print or publish the run keep their defaults.
+    Options options;
+    options.timeline = TIMELINE_NONE;
+    options.analytic = config.analytic ? ANALYTIC_ON : ANALYTIC_OFF;
+    options.stride = config.stride;
+    options.pairing_heap = config.pairing_heap;
+    options.aging = config.aging;
+    options.aging_period = config.aging_period;
+    options.switch_cost = config.switch_cost;
+    options.cache_refill = config.cache_refill;
+    options.cache_half_life = config.cache_half_life;
+    options.program = config.program;
+    options.adaptive_window = config.adaptive_window;
+    options.parallel = config.parallel;
+
+    ObserverAdapter adapter(config.observer);
+    Kernel(&arrivals, options).simulate_result(
+        config.scheduler_type, config.quantum,
+        config.observer ? &adapter : nullptr, result);
+    return result;
+}
@@ -0,0 +1,143 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <span>
+#include <string>
+#include <vector>
+
+/**
+ * @file simulation.h
+ * @brief The API of the simulation library (libscheduler): simulates a
+ * workload in memory and returns its statistics, without any console output,
+ * so a program can run many simulations without starting the simulator and
+ * reading its text output. The header only depends on the standard library.
+ */
+
+/**
+ * @brief A process of a workload, as a line of a workload file.
+ */
+struct ProcessSpec {
+    unsigned long creation_time = 0;
+    unsigned long duration = 0;             // Of the first CPU burst
+    unsigned long priority = 0;
+    std::vector<unsigned long> bursts;      // I/O and CPU bursts after the
+                                            // first one, alternately
+    std::string group;                      // Of the fair share scheduler
+};
+
+/**
+ * @brief The states of a process, as given to a SimulationObserver.
+ */
+enum ProcessState {
+    PROCESS_NEW,
+    PROCESS_READY,
+    PROCESS_RUNNING,
+    PROCESS_DONE,
+    PROCESS_BLOCKED
+};
+
+/**
+ * @class SimulationObserver
+ * @brief Abstract class notified of every state change of a process (see
+ * ProcessState) as the simulation goes.
+ */
+class SimulationObserver {
+public:
+    virtual ~SimulationObserver() {}
+
+    virtual void on_transition(unsigned long pid,
+                               unsigned long from,
+                               unsigned long to,
+                               unsigned long current_time) = 0;
+};
+
+/**
+ * @brief The statistics of a process. Its pid is its index in
+ * SimulationResult::processes plus one.
+ */
+struct ProcessRecord {
+    unsigned long creation_time;
+    unsigned long start;            // ULONG_MAX if it never ran
+    unsigned long end;
+    unsigned long waiting_time;
+    unsigned long context_changes;
+    unsigned long io_time;
+
+    unsigned long turnaround_time() const {
+        return end - creation_time;
+    }
+};
+
+/**
+ * @brief What to simulate: the scheduler and the options of the command line
+ * that apply to a single run, with the same defaults.
+ */
+struct SimulationConfig {
+    unsigned long scheduler_type = 1;   // 1 FCFS, 2 SJF, 3 and 4 priorities
+                                        // without and with preemption, 5
+                                        // Round Robin, 6 adaptive, 7 fair
+                                        // share
+    unsigned long quantum = 2;
+    bool analytic = false;              // --analytic
+    bool stride = false;                // --stride
+    bool pairing_heap = false;          // --pairing-heap
+    bool aging = false;                 // --aging=<aging_period>
+    unsigned long aging_period = 0;
+    double switch_cost = 0;             // --switch-cost, in milliseconds
+    double cache_refill = 0;
+    double cache_half_life = 10;        // Seconds
+    std::string program;                // --program, empty for none
+    unsigned long adaptive_window = 2;  // --adaptive-window, in seconds
+    unsigned long parallel = 0;         // --parallel, in threads
+    SimulationObserver* observer = nullptr;     // Not owned. Runs on a
+                                                // single thread if set.
+};
+
+/**
+ * @brief The statistics of a run, as the simulator prints them.
+ */
+struct SimulationResult {
+    std::vector<ProcessRecord> processes;   // By pid, children included
+    unsigned long total_turnaround_time = 0;
+    unsigned long total_waiting_time = 0;
+    unsigned long total_io_time = 0;
+    unsigned long context_changes = 0;
+    unsigned long preemptions = 0;
+    unsigned long makespan = 0;             // End of the last process
+    std::string error;      // Why the run could not be done; empty if it was,
+                            // and the statistics are only valid then
+
+    double average_turnaround_time() const {
+        return average(total_turnaround_time);
+    }
+
+    double average_waiting_time() const {
+        return average(total_waiting_time);
+    }
+
+    double average_io_time() const {
+        return average(total_io_time);
+    }
+
+private:
+    double average(unsigned long total) const {
+        return processes.empty() ? 0 :
+               static_cast<double>(total) / processes.size();
+    }
+};
+
+/**
+ * @brief Simulates a workload with the scheduler of config. The workload does
+ * not need to be sorted: as with a workload file, its processes are ordered
+ * by creation time and numbered in that order. The observer of config, if
+ * any, is notified of every state change of the processes as the simulation
+ * goes. Nothing is printed: a configuration or workload that cannot be
+ * simulated is reported in the error of the result.
+ *
+ * Simulations do not share state, so they may run on several threads at
+ * once, except in the compact build (see COMPACT_PROCESS).
+ */
+SimulationResult simulate_workload(std::span<const ProcessSpec> workload,
+                                   const SimulationConfig& config);
+
+#endif // SIMULATION_H
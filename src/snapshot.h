@@ -0,0 +1,119 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "process.h"
+
+/**
+ * @class SnapshotFile
+ * @brief Binary file of 64 bit words holding the state of a simulation, read
+ * or written sequentially.
+ *
+ * A failed read or write makes the file bad for good, and reads return zeros
+ * from then on, so a caller can read a whole structure and check good once.
+ * The words are in the byte order of the machine: a snapshot is only meant
+ * to be read back where it was written.
+ */
+class SnapshotFile {
+public:
+    SnapshotFile(const std::string& file_name, bool write) :
+        file(std::fopen(file_name.c_str(), write ? "wb" : "rb")),
+        failed(false) {}
+
+    ~SnapshotFile() {
+        close();
+    }
+
+    bool good() const {
+        return file && !failed;
+    }
+
+    /**
+     * @brief Flushes and closes the file.
+     * @return True if every read or write succeeded.
+     */
+    bool close() {
+        if (file) {
+            failed = std::fclose(file) != 0 || failed;
+            file = nullptr;
+            return !failed;
+        }
+        return false;
+    }
+
+    void put(uint64_t value) {
+        if (good() && std::fwrite(&value, sizeof(value), 1, file) != 1)
+            failed = true;
+    }
+
+    uint64_t get() {
+        uint64_t value = 0;
+        if (good() && std::fread(&value, sizeof(value), 1, file) != 1) {
+            failed = true;
+            value = 0;
+        }
+        return value;
+    }
+
+    void put_double(double value) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        put(bits);
+    }
+
+    double get_double() {
+        uint64_t bits = get();
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    void put(const ProcessSnapshot& process) {
+        put(process.pid);
+        put(process.duration);
+        put(process.priority);
+        put(process.creation_time);
+        put(process.total_execution_time);
+        put(process.state);
+        put(process.start);
+        put(process.end);
+        put(process.waiting_time);
+        put(process.last_interrupt);
+        put(process.context_changes);
+        put(process.io_time);
+        put(process.next_burst);
+        put(process.bursts.size());
+        for (unsigned long burst : process.bursts)
+            put(burst);
+    }
+
+    void get(ProcessSnapshot& process) {
+        process.pid = get();
+        process.duration = get();
+        process.priority = get();
+        process.creation_time = get();
+        process.total_execution_time = get();
+        process.state = get();
+        process.start = get();
+        process.end = get();
+        process.waiting_time = get();
+        process.last_interrupt = get();
+        process.context_changes = get();
+        process.io_time = get();
+        process.next_burst = get();
+        uint64_t count = get();
+        process.bursts.clear();
+        for (uint64_t i = 0; i < count && good(); i++)
+            process.bursts.push_back(get());
+    }
+
+private:
+    std::FILE* file;
+    bool failed;
+};
+
+#endif // SNAPSHOT_H
@@ -1,7 +1,10 @@
 #ifndef SYSTEM_H
 #define SYSTEM_H
 
+#include "batch.h"
+#include "external_sort.h"
 #include "kernel.h"
+#include "result_cache.h"
 #include <vector>
 
 /**
@@ -12,32 +15,58 @@
 class System
 {
 public:
-	System(char* file_name) : file(file_name) {
-        file.read_file();
-        kernel = Kernel(file.get_processes_params());
+	System(char* file_name, const Options& options_ = Options()) :
+        file(file_name),
+        file_name(file_name),
+        arrivals(nullptr),
+        readable(true),
+        options(options_),
+        cache(nullptr) {
+        // Incremental runs read the file themselves, from their snapshot on,
+        // and batch runs read the workloads it lists.
+        if (options.incremental || options.batch != BATCH_OFF) {
+            kernel = Kernel(nullptr, options);
+            return;
+        }
+        // Runs that write other files than the output are not cached.
+        if (!options.cache_dir.empty() && options.trace_file.empty() &&
+            options.adaptive_log.empty()) {
+            cache = new ResultCache(options.cache_dir, options.cache_bytes);
+            if (!cache->is_open() || !workload.update_file(file_name)) {
+                delete cache;
+                cache = nullptr;
+            }
+        }
+        // With the cache, the workload is only read on the first miss.
+        if (!cache)
+            load_workload();
     }
 
-	~System() {}
+	~System() {
+        delete cache;
+        delete arrivals;
+    }
 
     /**
      * @brief Starts the system. It reads the file and starts the kernel.
      */
     void start(unsigned long scheduler_type, unsigned long quantum) {
 
-        std::string scheduling_types[] = {"First Come First Served",
-                                         "Shortest Job First",
-                                         "Priority, no preemption",
-                                         "Prioity, with preemption",
-                                         "Round Robin"};
+        if (options.batch != BATCH_OFF) {
+            run_batch(scheduler_type, quantum);
+
+        } else if (options.diff_type) {
+            run_diff(scheduler_type, quantum);
 
-        if (scheduler_type) {
-            kernel.start_scheduler(scheduler_type, quantum);
+        } else if (scheduler_type) {
+            run_scheduler(scheduler_type, quantum);
 
         } else {
             for (int i = 1; i <= 5; i++) {
-                std::cout << "Scheduler type: " << scheduling_types[i-1]
-                                                << std::endl << std::endl;
-                kernel.start_scheduler(i, quantum);
+                std::cout << "Scheduler type: "
+                          << SchedulerFactory().get_name(i)
+                          << std::endl << std::endl;
+                run_scheduler(i, quantum);
                 std::cout << std::endl;
             }
         }
@@ -45,7 +74,216 @@ public:
 
 private:
     File file;
+    char* file_name;
+    ArrivalSource* arrivals;
+    bool readable;              // False if the workload could not be read
 	Kernel kernel;
+    Options options;
+    ResultCache* cache;
+    ResultHasher workload;     // Hash of the bytes of the input file
+
+    /**
+     * @brief Reads the workload and creates the kernel that simulates it.
+     * Nothing is simulated if the workload could not be read (see readable).
+     */
+    void load_workload() {
+        // Large workloads are sorted on disk and streamed to the kernel.
+        if (options.run_records) {
+            ExternalArrivalSource* source =
+                new ExternalArrivalSource(file_name, options.run_records,
+                                          options.tmp_dir);
+            readable = source->is_good();
+            arrivals = source;
+        } else {
+            file.read_file();
+            arrivals = new VectorArrivalSource(file.get_processes_params());
+        }
+        kernel = Kernel(arrivals, options);
+    }
+
+    /**
+     * @brief Runs a scheduler, or writes its output from the result cache if
+     * the same run was cached before.
+     */
+    void run_scheduler(unsigned long scheduler_type, unsigned long quantum) {
+        if (options.incremental) {
+            kernel.start_incremental(scheduler_type, quantum, file_name);
+            return;
+        }
+        if (!cache) {
+            if (readable)
+                kernel.start_scheduler(scheduler_type, quantum);
+            return;
+        }
+        ResultKey key = result_key(scheduler_type, quantum);
+        if (cache->replay(key, STDOUT_FILENO))
+            return;
+        if (!arrivals)
+            load_workload();
+        if (!readable)
+            return;
+        bool capturing = cache->begin_capture();
+        bool done = kernel.start_scheduler(scheduler_type, quantum);
+        // The error of a run that failed is not its result.
+        if (capturing && done)
+            cache->end_capture(key);
+        else if (capturing)
+            cache->cancel_capture();
+    }
+
+    /**
+     * @brief Runs the scheduler and the one of --diff on the workload and
+     * prints how their runs differ. The comparison is not cached.
+     */
+    void run_diff(unsigned long scheduler_type, unsigned long quantum) {
+        if (!scheduler_type || options.incremental) {
+            std::cout << "Erro: --diff precisa de um tipo de escalonador e "
+                         "não aceita --incremental" << std::endl;
+            return;
+        }
+        if (!arrivals)
+            load_workload();
+        if (!readable)
+            return;
+        kernel.start_diff(scheduler_type, quantum, options.diff_type,
+                          options.diff_quantum ? options.diff_quantum : quantum);
+    }
+
+    /**
+     * @brief Simulates the workloads listed in the input file, one file name
+     * per line, with the batch engine, and prints the statistics of each one
+     * as a line of CSV.
+     */
+    void run_batch(unsigned long scheduler_type, unsigned long quantum) {
+        if (scheduler_type != FCFS && scheduler_type != RR) {
+            std::cout << "Erro: --batch só aceita os escalonadores FCFS (1) e "
+                         "Round Robin (5)" << std::endl;
+            return;
+        }
+        if (options.switch_cost > 0 || options.cache_refill > 0) {
+            std::cout << "Erro: --batch não aceita --switch-cost" << std::endl;
+            return;
+        }
+        std::ifstream list(file_name);
+        std::vector<BatchEngine::Workload> workloads;
+        std::string line;
+        while (std::getline(list, line)) {
+            if (line.empty())
+                continue;
+            workloads.emplace_back();
+            if (!BatchEngine::load(line, workloads.back())) {
+                std::cout << "Erro: a carga " << line
+                          << " não pode ser lida, tem E/S ou é longa demais"
+                          << std::endl;
+                workloads.pop_back();
+            }
+        }
+
+        std::vector<std::vector<BatchEngine::ProcessResult>> results;
+        BatchEngine(scheduler_type == RR, quantum).run(workloads, results);
+
+        std::cout << "workload,processes,average_turnaround_time,"
+                     "average_waiting_time,context_changes" << std::endl;
+        for (std::size_t i = 0; i < workloads.size(); i++) {
+            // Averaged as Kernel::print_statistics does.
+            float turnaround_time = 0;
+            float waiting_time = 0;
+            unsigned long context_changes = 0;
+            std::size_t count = results[i].size();
+            for (std::size_t pid = 0; pid < count; pid++) {
+                const BatchEngine::ProcessResult& result = results[i][pid];
+                turnaround_time += result.end - workloads[i].creation[pid];
+                waiting_time += result.waiting_time;
+                context_changes += result.context_changes;
+            }
+            std::cout << workloads[i].name << "," << count << ","
+                      << turnaround_time / count << ","
+                      << waiting_time / count << "," << context_changes << "\n";
+        }
+        std::cout.flush();
+
+        if (options.batch == BATCH_CHECK)
+            check_batch(scheduler_type, quantum, workloads, results);
+    }
+
+    /**
+     * @brief Simulates each workload of a batch with the kernel and prints
+     * the processes whose statistics differ from the batch engine's.
+     */
+    void check_batch(unsigned long scheduler_type, unsigned long quantum,
+        const std::vector<BatchEngine::Workload>& workloads,
+        const std::vector<std::vector<BatchEngine::ProcessResult>>& results) {
+        Options scalar;
+        scalar.timeline = TIMELINE_NONE;
+        scalar.stride = true;
+        unsigned long mismatches = 0;
+        std::vector<ProcessRecord> records;
+        for (std::size_t i = 0; i < workloads.size(); i++) {
+            File workload(const_cast<char*>(workloads[i].name.c_str()));
+            workload.read_file();
+            VectorArrivalSource source(workload.get_processes_params());
+            records.clear();
+            if (!Kernel(&source, scalar).simulate_records(scheduler_type,
+                                                          quantum, records))
+                continue;
+            for (std::size_t pid = 0; pid < records.size(); pid++) {
+                const ProcessRecord& simulated = records[pid];
+                const BatchEngine::ProcessResult& batch = results[i][pid];
+                if (simulated.start == batch.start &&
+                    simulated.end == batch.end &&
+                    simulated.waiting_time == batch.waiting_time &&
+                    simulated.context_changes == batch.context_changes)
+                    continue;
+                if (++mismatches <= 10)
+                    std::cout << workloads[i].name << " P" << pid + 1
+                              << ": batch [start " << batch.start
+                              << ", end " << batch.end
+                              << ", WT " << batch.waiting_time
+                              << ", CC " << batch.context_changes
+                              << "] simulated [start " << simulated.start
+                              << ", end " << simulated.end
+                              << ", WT " << simulated.waiting_time
+                              << ", CC " << simulated.context_changes << "]"
+                              << std::endl;
+            }
+        }
+        if (mismatches)
+            std::cout << "Batch cross-check: " << mismatches
+                      << " processes differ" << std::endl;
+        else
+            std::cout << "Batch cross-check: OK (" << workloads.size()
+                      << " workloads)" << std::endl;
+    }
+
+    /**
+     * @return The key of a run: the workload, the scheduler, the quantum, the
+     * version of the output and every option that changes the output.
+     */
+    ResultKey result_key(unsigned long scheduler_type, unsigned long quantum) {
+        ResultHasher hasher = workload;
+        hasher.update(std::string(ResultCache::VERSION));
+        #ifdef DEBUG
+        hasher.update(std::string("debug"));
+        #endif
+        hasher.update(scheduler_type);
+        hasher.update(quantum);
+        hasher.update(options.timeline);
+        hasher.update(options.first_pid);
+        hasher.update(options.last_pid);
+        hasher.update(options.header_interval);
+        hasher.update(options.analytic);
+        hasher.update(static_cast<unsigned long>(options.retire));
+        hasher.update(options.program);
+        hasher.update(options.adaptive_window);
+        hasher.update(static_cast<unsigned long>(options.aging));
+        hasher.update(options.aging_period);
+        hasher.update(static_cast<unsigned long>(options.pairing_heap));
+        hasher.update(&options.switch_cost, sizeof(options.switch_cost));
+        hasher.update(&options.cache_refill, sizeof(options.cache_refill));
+        hasher.update(&options.cache_half_life,
+                      sizeof(options.cache_half_life));
+        return hasher.key();
+    }
 };
 
 
@@ -0,0 +1,158 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <climits>
+#include <vector>
+#include "options.h"
+#include "output_pipeline.h"
+#include "process.h"
+
+/**
+ * @class TimelineRenderer
+ * @brief Chooses the columns of the scheduling timeline and pushes each row
+ * to a TimelineWriter.
+ *
+ * TIMELINE_FULL prints one column per process, as in the original grid.
+ * TIMELINE_WINDOW prints only the columns of a pid range. TIMELINE_ACTIVE
+ * tracks the processes that were created and are not DONE yet and prints only
+ * those, reprinting the header whenever that set changes. A row therefore
+ * costs O(columns) instead of O(total processes).
+ */
+class TimelineRenderer {
+public:
+    TimelineRenderer(const Options& options, unsigned long total_processes_) :
+        mode(options.timeline),
+        header_interval(options.header_interval),
+        first_pid(1),
+        last_pid(total_processes_),
+        max_pid(ULONG_MAX),
+        rows_since_header(0),
+        columns_changed(false) {
+        if (mode == TIMELINE_WINDOW) {
+            first_pid = options.first_pid;
+            last_pid = std::min(options.last_pid, total_processes_);
+            max_pid = options.last_pid;
+        }
+    }
+
+    ~TimelineRenderer() {}
+
+    /**
+     * @brief Prints the first header.
+     */
+    void setup() {
+        if (mode != TIMELINE_ACTIVE)
+            print_header();
+    }
+
+    /**
+     * @brief Adds a created process to the active set. Processes are created
+     * in pid order, so the set stays sorted. In the other modes, adds the
+     * columns of processes spawned beyond the workload.
+     */
+    void track(Process* process) {
+        if (mode == TIMELINE_ACTIVE) {
+            active.push_back(process);
+            columns_changed = true;
+        } else if (process->get_pid() > last_pid &&
+                   process->get_pid() <= max_pid) {
+            last_pid = process->get_pid();
+            columns_changed = true;
+        }
+    }
+
+    /**
+     * @brief Prints the row of the current time.
+     * @param processes The created processes, indexed by pid - 1.
+     * @param switching_pid The process the CPU spends the second switching
+     * to, shown as SWITCHING, or 0.
+     */
+    void render(unsigned long current_time,
+                const std::vector<Process*>& processes,
+                unsigned long switching_pid) {
+        if (mode == TIMELINE_ACTIVE)
+            drop_finished();
+
+        if (columns_changed ||
+            (header_interval && rows_since_header >= header_interval))
+            print_header();
+
+        row_states.clear();
+        if (mode == TIMELINE_ACTIVE) {
+            for (Process* process : active)
+                row_states.push_back(process->get_state_id());
+        } else {
+            for (unsigned long pid = first_pid; pid <= last_pid; pid++)
+                row_states.push_back(pid <= processes.size() ?
+                                     processes[pid - 1]->get_state_id() :
+                                     static_cast<unsigned long>(NEW));
+        }
+        if (switching_pid)
+            mark_switching(switching_pid);
+        writer.begin_row(current_time);
+        writer.row_states(row_states.data(), row_states.size());
+        writer.end_line();
+        rows_since_header++;
+    }
+
+    /**
+     * @brief Waits until the whole timeline has been written.
+     */
+    void close() {
+        writer.close();
+    }
+
+private:
+    unsigned long mode;
+    unsigned long header_interval;
+    unsigned long first_pid;
+    unsigned long last_pid;
+    unsigned long max_pid;
+    unsigned long rows_since_header;
+    bool columns_changed;
+    std::vector<Process*> active;
+    std::vector<unsigned char> row_states;
+    std::vector<unsigned long> header;
+    TimelineWriter writer;
+
+    void mark_switching(unsigned long pid) {
+        if (mode == TIMELINE_ACTIVE) {
+            for (std::size_t i = 0; i < active.size(); i++)
+                if (active[i]->get_pid() == pid)
+                    row_states[i] = SWITCHING;
+        } else if (pid >= first_pid && pid <= last_pid) {
+            row_states[pid - first_pid] = SWITCHING;
+        }
+    }
+
+    // Removes the DONE processes from the active set, keeping the pid order.
+    void drop_finished() {
+        std::size_t kept = 0;
+        for (Process* process : active) {
+            if (process->get_state_id() != DONE)
+                active[kept++] = process;
+        }
+        if (kept != active.size()) {
+            active.resize(kept);
+            columns_changed = true;
+        }
+    }
+
+    void print_header() {
+        header.clear();
+        if (mode == TIMELINE_ACTIVE) {
+            for (Process* process : active)
+                header.push_back(process->get_pid());
+        } else {
+            for (unsigned long pid = first_pid; pid <= last_pid; pid++)
+                header.push_back(pid);
+        }
+        writer.begin_header();
+        writer.header_pids(header.data(), header.size());
+        writer.end_line();
+        rows_since_header = 0;
+        columns_changed = false;
+    }
+};
+
+#endif // TIMELINE_H
@@ -0,0 +1,202 @@
+#ifndef TIMING_WHEEL_H
+#define TIMING_WHEEL_H
+
+#include <climits>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @class TimingWheel
+ * @brief Hierarchical timing wheel of events of type T, keyed by the simulated
+ * time at which they are due.
+ *
+ * Each level has 64 slots and covers 64 times the range of the level below.
+ * An event is stored on the level of the highest 6 bit digit in which its time
+ * differs from the current time of the wheel, in the slot of that digit, so
+ * the events of a level are always later than the ones of the levels below. A
+ * bitmap per level marks the occupied slots. Scheduling an event is O(1);
+ * advancing the wheel moves down the events of the slots it enters, so each
+ * event is moved at most once per level. Nodes are taken from a pool that is
+ * only freed with the wheel.
+ */
+template <typename T>
+class TimingWheel {
+public:
+    TimingWheel() :
+        now(0),
+        pending(0),
+        cached_expiry(ULONG_MAX),
+        expiry_valid(true),
+        free_nodes(nullptr) {
+        for (unsigned level = 0; level < LEVELS; level++) {
+            occupied[level] = 0;
+            for (unsigned slot = 0; slot < SLOTS; slot++)
+                slots[level][slot] = nullptr;
+        }
+    }
+
+    ~TimingWheel() {
+        for (Node* block : blocks)
+            delete[] block;
+    }
+
+    /**
+     * @brief Schedules an event. Events scheduled before the current time of
+     * the wheel are due at the current time.
+     */
+    void schedule(unsigned long time, const T& value) {
+        Node* node = allocate();
+        node->time = time < now ? now : time;
+        node->value = value;
+        insert(node);
+        pending++;
+        if (expiry_valid && node->time < cached_expiry)
+            cached_expiry = node->time;
+    }
+
+    /**
+     * @return The time of the earliest pending event, or ULONG_MAX if there is
+     * none. The bitmaps find its slot in O(levels); the slot is scanned only
+     * when it is not on the first level, and the result is cached until the
+     * wheel changes.
+     */
+    unsigned long next_expiry() {
+        if (expiry_valid)
+            return cached_expiry;
+        expiry_valid = true;
+        cached_expiry = ULONG_MAX;
+        for (unsigned level = 0; level < LEVELS; level++) {
+            if (!occupied[level])
+                continue;
+            unsigned slot = __builtin_ctzll(occupied[level]);
+            if (level == 0) {
+                cached_expiry = (now & ~(SLOTS - 1ul)) | slot;
+            } else {
+                for (Node* node = slots[level][slot]; node; node = node->next)
+                    if (node->time < cached_expiry)
+                        cached_expiry = node->time;
+            }
+            break;
+        }
+        return cached_expiry;
+    }
+
+    /**
+     * @brief Advances the wheel to the given time and appends the values of
+     * the events due up to it to expired, in time order. Events due at the
+     * same time are appended in no particular order.
+     */
+    void advance(unsigned long time, std::vector<T>& expired) {
+        unsigned long expiry;
+        while ((expiry = next_expiry()) <= time) {
+            move_to(expiry);
+            Node* node = slots[0][expiry & (SLOTS - 1)];
+            slots[0][expiry & (SLOTS - 1)] = nullptr;
+            occupied[0] &= ~(1ull << (expiry & (SLOTS - 1)));
+            while (node) {
+                Node* next = node->next;
+                expired.push_back(node->value);
+                release(node);
+                pending--;
+                node = next;
+            }
+            expiry_valid = false;
+        }
+        if (time > now)
+            move_to(time);
+    }
+
+    bool empty() const {
+        return pending == 0;
+    }
+
+    std::size_t size() const {
+        return pending;
+    }
+
+    /**
+     * @brief Calls visit(time, value) for every pending event, in no
+     * particular order.
+     */
+    template <typename Visitor>
+    void for_each(Visitor visit) const {
+        for (unsigned level = 0; level < LEVELS; level++)
+            for (unsigned slot = 0; slot < SLOTS; slot++)
+                for (Node* node = slots[level][slot]; node; node = node->next)
+                    visit(node->time, node->value);
+    }
+
+private:
+    static constexpr unsigned LEVEL_BITS = 6;
+    static constexpr unsigned SLOTS = 1 << LEVEL_BITS;
+    static constexpr unsigned LEVELS = (64 + LEVEL_BITS - 1) / LEVEL_BITS;
+    static constexpr std::size_t BLOCK_NODES = 1024;
+
+    struct Node {
+        unsigned long time;
+        T value;
+        Node* next;
+    };
+
+    unsigned long now;
+    std::size_t pending;
+    unsigned long cached_expiry;
+    bool expiry_valid;
+    Node* slots[LEVELS][SLOTS];
+    uint64_t occupied[LEVELS];
+    Node* free_nodes;
+    std::vector<Node*> blocks;
+
+    static unsigned digit(unsigned long time, unsigned level) {
+        return (time >> (level * LEVEL_BITS)) & (SLOTS - 1);
+    }
+
+    void insert(Node* node) {
+        unsigned long difference = node->time ^ now;
+        unsigned level = difference ?
+            (63 - __builtin_clzl(difference)) / LEVEL_BITS : 0;
+        unsigned slot = digit(node->time, level);
+        node->next = slots[level][slot];
+        slots[level][slot] = node;
+        occupied[level] |= 1ull << slot;
+    }
+
+    // Sets the current time, which must not be later than any pending event.
+    // The events of the slots of the new time agree with it on one more digit,
+    // so they are moved to lower levels, from the top level down.
+    void move_to(unsigned long time) {
+        now = time;
+        for (unsigned level = LEVELS - 1; level > 0; level--) {
+            unsigned slot = digit(time, level);
+            if (!(occupied[level] & (1ull << slot)))
+                continue;
+            Node* node = slots[level][slot];
+            slots[level][slot] = nullptr;
+            occupied[level] &= ~(1ull << slot);
+            while (node) {
+                Node* next = node->next;
+                insert(node);
+                node = next;
+            }
+        }
+    }
+
+    Node* allocate() {
+        if (!free_nodes) {
+            Node* block = new Node[BLOCK_NODES];
+            blocks.push_back(block);
+            for (std::size_t i = 0; i < BLOCK_NODES; i++)
+                release(&block[i]);
+        }
+        Node* node = free_nodes;
+        free_nodes = node->next;
+        return node;
+    }
+
+    void release(Node* node) {
+        node->next = free_nodes;
+        free_nodes = node;
+    }
+};
+
+#endif // TIMING_WHEEL_H
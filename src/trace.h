@@ -0,0 +1,229 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include "transition.h"
+
+enum TraceFormat {
+    TRACE_JSON,
+    TRACE_PERFETTO
+};
+
+/**
+ * @class TraceWriter
+ * @brief Streams the state transitions of the simulated processes to a file
+ * that can be opened in chrome://tracing, Perfetto or other trace viewers.
+ *
+ * Each scheduler run becomes a trace process and each simulated pid a track
+ * (a thread) of it. READY, RUNNING and BLOCKED are slices that begin and end at the
+ * transitions, preemptions and completions are instant events. One simulated
+ * second is one second of trace time. Events are written as soon as they
+ * happen through a fixed size buffer, so the memory used does not depend on
+ * the number of processes.
+ *
+ * TRACE_JSON writes the Chrome trace event format. TRACE_PERFETTO writes the
+ * Perfetto protobuf format (TracePacket with TrackDescriptor and TrackEvent).
+ */
+class TraceWriter : public TransitionObserver {
+public:
+    TraceWriter(const std::string& file_name, unsigned long format_) :
+        format(format_),
+        run(0),
+        first_event(true) {
+        file = std::fopen(file_name.c_str(), "wb");
+        if (!file)
+            std::cout << "Erro ao criar o arquivo de trace "
+                      << file_name << std::endl;
+        buffer.reserve(BUFFER_SIZE * 2);
+        if (format == TRACE_JSON) {
+            buffer += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        } else {
+            // Marks the start of the packet sequence (incremental state
+            // cleared), which the Perfetto importer expects.
+            std::string packet;
+            varint_field(packet, 10, SEQUENCE_ID);
+            varint_field(packet, 13, 1);
+            bytes_field(buffer, 1, packet);
+        }
+    }
+
+    ~TraceWriter() {
+        if (format == TRACE_JSON)
+            buffer += "\n]}\n";
+        flush();
+        if (file)
+            std::fclose(file);
+    }
+
+    /**
+     * @brief Starts a new trace process for a scheduler run.
+     */
+    void begin_run(const std::string& name) {
+        run++;
+        if (format == TRACE_JSON) {
+            begin_event();
+            buffer += "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":";
+            buffer += std::to_string(run);
+            buffer += ",\"args\":{\"name\":\"";
+            buffer += name;
+            buffer += "\"}}";
+        } else {
+            track_descriptor(run_uuid(), 0, name);
+        }
+    }
+
+    void on_transition(const Process& process,
+                       unsigned long from,
+                       unsigned long to,
+                       unsigned long current_time) override {
+        unsigned long pid = process.get_pid();
+        if (from == NEW)
+            name_track(pid);
+        if (from == READY || from == RUNNING || from == BLOCKED)
+            event(pid, current_time, SLICE_END, nullptr);
+        if (from == RUNNING && to == READY)
+            event(pid, current_time, INSTANT, "preempted");
+        if (to == READY || to == RUNNING || to == BLOCKED)
+            event(pid, current_time, SLICE_BEGIN, state_name(to));
+        if (to == DONE)
+            event(pid, current_time, INSTANT, "done");
+        if (buffer.size() >= BUFFER_SIZE)
+            flush();
+    }
+
+private:
+    static constexpr std::size_t BUFFER_SIZE = 1 << 20;
+    static constexpr uint32_t SEQUENCE_ID = 1;
+
+    enum EventType {
+        SLICE_BEGIN = 1,
+        SLICE_END,
+        INSTANT
+    };
+
+    unsigned long format;
+    unsigned long run;
+    bool first_event;
+    std::FILE* file;
+    std::string buffer;
+
+    static const char* state_name(unsigned long state) {
+        switch (state) {
+        case RUNNING:
+            return "RUNNING";
+        case BLOCKED:
+            return "BLOCKED";
+        default:
+            return "READY";
+        }
+    }
+
+    uint64_t run_uuid() const {
+        return static_cast<uint64_t>(run) << 40;
+    }
+
+    void name_track(unsigned long pid) {
+        std::string name = "P" + std::to_string(pid);
+        if (format == TRACE_JSON) {
+            begin_event();
+            buffer += "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":";
+            buffer += std::to_string(run);
+            buffer += ",\"tid\":";
+            buffer += std::to_string(pid);
+            buffer += ",\"args\":{\"name\":\"";
+            buffer += name;
+            buffer += "\"}}";
+        } else {
+            track_descriptor(run_uuid() + pid, run_uuid(), name);
+        }
+    }
+
+    void event(unsigned long pid, unsigned long time, int type,
+               const char* name) {
+        if (format == TRACE_JSON) {
+            static const char* phases[] = {"", "B", "E", "i"};
+            begin_event();
+            buffer += "{\"ph\":\"";
+            buffer += phases[type];
+            buffer += "\",\"pid\":";
+            buffer += std::to_string(run);
+            buffer += ",\"tid\":";
+            buffer += std::to_string(pid);
+            buffer += ",\"ts\":";
+            buffer += std::to_string(time * 1000000ul);
+            if (name) {
+                buffer += ",\"name\":\"";
+                buffer += name;
+                buffer += "\"";
+            }
+            if (type == INSTANT)
+                buffer += ",\"s\":\"t\"";
+            buffer += "}";
+        } else {
+            std::string track_event;
+            varint_field(track_event, 9, type);
+            varint_field(track_event, 11, run_uuid() + pid);
+            if (name)
+                bytes_field(track_event, 23, name);
+
+            std::string packet;
+            varint_field(packet, 8, time * 1000000000ul);
+            varint_field(packet, 10, SEQUENCE_ID);
+            bytes_field(packet, 11, track_event);
+            bytes_field(buffer, 1, packet);
+        }
+    }
+
+    void begin_event() {
+        if (!first_event)
+            buffer += ",";
+        buffer += "\n";
+        first_event = false;
+    }
+
+    void track_descriptor(uint64_t uuid, uint64_t parent, const std::string& name) {
+        std::string descriptor;
+        varint_field(descriptor, 1, uuid);
+        bytes_field(descriptor, 2, name);
+        if (parent)
+            varint_field(descriptor, 5, parent);
+
+        std::string packet;
+        varint_field(packet, 10, SEQUENCE_ID);
+        bytes_field(packet, 60, descriptor);
+        bytes_field(buffer, 1, packet);
+    }
+
+    // Protobuf wire format: a varint field is (number << 3 | 0) followed by
+    // the value, a length delimited field is (number << 3 | 2), the length
+    // and the bytes.
+    static void varint(std::string& out, uint64_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<char>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    static void varint_field(std::string& out, uint32_t number, uint64_t value) {
+        varint(out, number << 3);
+        varint(out, value);
+    }
+
+    static void bytes_field(std::string& out, uint32_t number,
+                            const std::string& value) {
+        varint(out, number << 3 | 2);
+        varint(out, value.size());
+        out += value;
+    }
+
+    void flush() {
+        if (file && !buffer.empty())
+            std::fwrite(buffer.data(), 1, buffer.size(), file);
+        buffer.clear();
+    }
+};
+
+#endif // TRACE_H
@@ -0,0 +1,46 @@
+#ifndef TRANSITION_H
+#define TRANSITION_H
+
+#include "process.h"
+
+/**
+ * @class TransitionObserver
+ * @brief Abstract class notified of every state change of a process (see
+ * States), such as READY -> RUNNING on a dispatch or RUNNING -> READY on a
+ * preemption.
+ */
+class TransitionObserver {
+public:
+    virtual ~TransitionObserver() {}
+
+    /**
+     * @brief Called after the process changed from state from to state to.
+     */
+    virtual void on_transition(const Process& process,
+                               unsigned long from,
+                               unsigned long to,
+                               unsigned long current_time) = 0;
+};
+
+enum BurstEnd {
+    BURST_FINISHED,     // The process is done, or blocks if it has I/O left
+    BURST_EXTENDED,     // The process got more CPU time and keeps running
+    BURST_YIELDED,      // The process got a new CPU burst and yields the CPU
+    BURST_BLOCKED       // The process blocks (see ProgramRunner::io_duration)
+};
+
+/**
+ * @class BurstObserver
+ * @brief Abstract class asked what a process does when it is done with its
+ * CPU burst, before the scheduler takes it off the CPU. Processes driven by
+ * programs (see program.h) decide it as they run.
+ */
+class BurstObserver {
+public:
+    virtual ~BurstObserver() {}
+
+    virtual BurstEnd on_burst_end(Process& process,
+                                  unsigned long current_time) = 0;
+};
+
+#endif // TRANSITION_H
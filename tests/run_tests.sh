@@ -0,0 +1,128 @@
+#!/bin/bash
+# Runs generated workloads through every mode that must give the same output
+# as the plain simulation, second by second, and compares the outputs.
+#
+# Usage: tests/run_tests.sh <scheduler> <compact scheduler> <input generator>
+#
+# The workloads are random, so each run checks new ones. The directory of a
+# failed run is kept, with the workloads and the outputs that differ.
+
+SCHEDULER=$(realpath "${1:-bin/scheduler}")
+COMPACT=$(realpath "${2:-bin/scheduler_compact}")
+GENERATOR=$(realpath "${3:-bin/input_generator}")
+
+DIR=$(mktemp -d "${TMPDIR:-/tmp}/scheduler-tests-XXXXXX") || exit 1
+cd "$DIR" || exit 1
+
+checks=0
+failures=0
+
+# Compares the output of a run with the expected one.
+# Usage: expect_same <name> <expected file> <binary> <args...>
+expect_same() {
+    local name=$1 expected=$2 binary=$3
+    shift 3
+    checks=$((checks + 1))
+    "$binary" "$@" > actual 2>&1
+    if ! cmp -s actual "$expected"; then
+        failures=$((failures + 1))
+        cp actual "failed-$failures.out"
+        cp "$expected" "failed-$failures.expected"
+        echo "FAIL $name: $* (see $DIR/failed-$failures.*)"
+    fi
+}
+
+# Checks that the output of a run has a line.
+# Usage: expect_line <name> <line> <binary> <args...>
+expect_line() {
+    local name=$1 line=$2 binary=$3
+    shift 3
+    checks=$((checks + 1))
+    if ! "$binary" "$@" 2>&1 | grep -q "^$line"; then
+        failures=$((failures + 1))
+        echo "FAIL $name: $* (no \"$line\")"
+    fi
+}
+
+# Generates a workload with the input generator.
+# Usage: generate <file> <generator args...>
+generate() {
+    local file=$1
+    shift
+    "$GENERATOR" "$@" > /dev/null && mv input.txt "$file"
+}
+
+generate cpu.txt 300 1500 12 9
+generate bursty.txt 300 1500 12 9 3
+generate ties.txt 200 30 8 4
+generate groups.txt 200 1000 10 5 0 3
+# Every third process does I/O once and every fifth one twice.
+awk 'BEGIN { srand() }
+     NR % 3 == 0 { print $0, int(rand() * 9) + 1, int(rand() * 5) + 1; next }
+     NR % 5 == 0 { print $0, int(rand() * 4) + 1, int(rand() * 6) + 1,
+                   int(rand() * 3) + 1, int(rand() * 2) + 1; next }
+     { print }' cpu.txt > io.txt
+
+for workload in cpu bursty ties groups io; do
+    file=$workload.txt
+    for type in 1 2 3 4 5 6 7; do
+        quantum=$((type % 3 + 2))
+        name="$workload type $type"
+        "$SCHEDULER" $file $type $quantum > timeline.out 2>&1
+        "$SCHEDULER" $file $type $quantum --timeline=none > expected.out 2>&1
+
+        expect_same "$name stride" timeline.out \
+            "$SCHEDULER" $file $type $quantum --stride
+        expect_same "$name stride, no timeline" expected.out \
+            "$SCHEDULER" $file $type $quantum --stride --timeline=none
+        expect_same "$name external sort" expected.out \
+            "$SCHEDULER" $file $type $quantum --external-sort=50 \
+            --tmpdir=. --timeline=none
+        expect_same "$name retire" expected.out \
+            "$SCHEDULER" $file $type $quantum --retire --tmpdir=. \
+            --timeline=none
+        expect_same "$name parallel" expected.out \
+            "$SCHEDULER" $file $type $quantum --parallel=4 --timeline=none
+        expect_same "$name compact" timeline.out \
+            "$COMPACT" $file $type $quantum
+        if [ $type -le 3 ]; then
+            expect_line "$name analytic" "Analytic cross-check: OK" \
+                "$SCHEDULER" $file $type --analytic=check --timeline=none
+        fi
+
+        # The file grows in three steps, each run resuming from the snapshot
+        # of the previous one.
+        if [ $type -le 6 ]; then
+            sort -s -n -k1,1 $file > sorted.txt
+            lines=$(wc -l < sorted.txt)
+            previous=0
+            rm -f growing.txt.snapshot-*
+            : > growing.txt
+            for part in 1 2 3; do
+                end=$((lines * part / 3))
+                sed -n "$((previous + 1)),${end}p" sorted.txt >> growing.txt
+                previous=$end
+                "$SCHEDULER" growing.txt $type $quantum --external-sort \
+                    --tmpdir=. --timeline=none > incremental.out 2>&1
+                expect_same "$name incremental, part $part" incremental.out \
+                    "$SCHEDULER" growing.txt $type $quantum --incremental
+            done
+        fi
+    done
+done
+
+# The batch engine does not take I/O.
+for workload in cpu bursty ties groups; do
+    echo "$DIR/$workload.txt"
+done > batch.txt
+for type in 1 5; do
+    expect_line "batch type $type" "Batch cross-check: OK" \
+        "$SCHEDULER" batch.txt $type 3 --batch=check
+done
+
+if [ $failures -ne 0 ]; then
+    echo "$failures of $checks checks failed (workloads in $DIR)"
+    exit 1
+fi
+cd / && rm -rf "$DIR"
+echo "All $checks checks passed"